@@ -0,0 +1,220 @@
+// benchmarks of the simulator, printed as one JSON object per line so the results of two versions can be compared
+// every benchmark repeats its work until it has run for long enough, and prints the time it took per operation
+// the end to end benchmarks simulate on a set of recordings generated here, so they don't need any recordings
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "../src/random.hpp"
+#include "../src/undertale.hpp"
+#include "../src/encounters.hpp"
+#include "../src/times.hpp"
+#include "../src/segments.hpp"
+#include "../src/structure_tables.hpp"
+#include "../src/recording_reader.hpp"
+#include "../src/probability_distribution.hpp"
+#include "../src/simulator.hpp"
+#include "../src/ruins.hpp"
+#include "../src/snowdin.hpp"
+#include "../src/waterfall.hpp"
+#include "../src/endgame.hpp"
+#include "../src/full_game.hpp"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// keeps the results of the benchmarked code from being optimized away
+static volatile std::int64_t sink;
+
+struct Settings {
+    // seconds each benchmark runs for at least
+    double seconds = 0.5;
+    int threads = std::max(1, (int) std::thread::hardware_concurrency());
+    // only the benchmarks with this in their name are run
+    string filter;
+};
+
+static Settings settings;
+
+// run `run(count)`, which does `count` operations, with more operations every time until it takes long enough,
+// and print the time per operation of the last run, along with the `threads` the operations were spread on
+static void benchmark (
+    const string& name, const function<void (std::int64_t count)>& run, const string& unit = "op", int threads = 1
+) {
+    if (name.find(settings.filter) == string::npos) return;
+    std::int64_t count = 1;
+    double seconds = 0;
+    while (true) {
+        auto start = chrono::steady_clock::now();
+        run(count);
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (seconds >= settings.seconds) break;
+        // aim a bit past the time left, without growing too much from a run that was too short to measure
+        double factor = seconds > 0 ? settings.seconds * 1.2 / seconds : 100;
+        count = (std::int64_t) (count * std::min(100.0, std::max(2.0, factor)));
+    }
+    cout << "{\"name\": \"" << name << "\", \"unit\": \"" << unit << "\", \"count\": " << count
+        << ", \"seconds\": " << seconds << ", \"ns_per_" << unit << "\": " << seconds * 1e9 / count
+        << ", \"" << unit << "s_per_second\": " << count / seconds << ", \"threads\": " << threads << "}" << endl;
+}
+
+// every name the times are built from, with a plausible value for it
+static unordered_map<string, int> synthetic_recording (Random& rng) {
+    unordered_map<string, int> values;
+    auto add = [&] (string_view name, int min, int max) {
+        values[string(name)] = min + (int) (rng.random_number() * (max - min));
+    };
+    const Structure::Tables& tables = Structure::tables;
+    for (int i = 0; i < tables.operation_count; i++) {
+        if (!tables.operations[i].source.empty()) add(tables.operations[i].source, 100, 900);
+    }
+    for (int segment = 0; segment < Segments::Count; segment++) {
+        add(segment_info[segment].name, 100, 900);
+    }
+    for (int i = 0; i < tables.room_count; i++) {
+        add(string(tables.rooms[i]) + "-steps", 200, 400);
+        add(string(tables.rooms[i]) + "-endsteps", 20, 60);
+    }
+    return values;
+}
+
+static void write_recording (const string& path, const unordered_map<string, int>& values) {
+    ofstream file(path);
+    for (const auto& pair : values) {
+        file << pair.first << "=" << pair.second << ";";
+    }
+}
+
+int main (int argc, char* argv[]) {
+    std::int64_t recordings = 50;
+    for (int i = 1; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--seconds" && i + 1 < argc) settings.seconds = stod(argv[++i]);
+        else if (option == "--threads" && i + 1 < argc) settings.threads = stoi(argv[++i]);
+        else if (option == "--filter" && i + 1 < argc) settings.filter = argv[++i];
+        else if (option == "--recordings" && i + 1 < argc) recordings = stoll(argv[++i]);
+        else {
+            cerr << "usage: benchmark [--seconds s] [--threads n] [--filter name] [--recordings n]" << endl;
+            return 1;
+        }
+    }
+    if (settings.threads < 1) {
+        cerr << "error: --threads must be at least 1" << endl;
+        return 1;
+    }
+
+    // the synthetic recordings, removed at the end
+    Random generator(1);
+    fs::path dir = fs::temp_directory_path() / ("simrec-benchmark-" + to_string(generator.next()));
+    fs::create_directories(dir);
+    for (std::int64_t i = 0; i < recordings; i++) {
+        write_recording((dir / ("recording_" + to_string(i))).string(), synthetic_recording(generator));
+    }
+    unordered_map<string, int> recording = synthetic_recording(generator);
+    string recording_path = (dir / "recording_0").string();
+
+    Random rng(2);
+    SampleContext context;
+    double total = 0;
+    std::int64_t int_total = 0;
+
+    benchmark("random_number", [&] (std::int64_t count) {
+        for (std::int64_t i = 0; i < count; i++) total += rng.random_number();
+        sink = total;
+    });
+    benchmark("scr_steps", [&] (std::int64_t count) {
+        for (std::int64_t i = 0; i < count; i++) int_total += Undertale::scr_steps(rng, context, 80, 40, 20, i % 20);
+        sink = int_total;
+    });
+
+    const pair<const char*, const EncounterTable*> tables[] = {
+        { "ruins1", &EncounterTables::ruins1 },
+        { "ruins3", &EncounterTables::ruins3 },
+        { "snowdin", &EncounterTables::snowdin },
+        { "glowing_water", &EncounterTables::glowing_water },
+        { "waterfall_grind", &EncounterTables::waterfall_grind },
+        { "core", &EncounterTables::core },
+    };
+    for (const auto& table : tables) {
+        benchmark(string("encounter_table/") + table.first, [&] (std::int64_t count) {
+            for (std::int64_t i = 0; i < count; i++) int_total += table.second->pick(rng.next());
+            sink = int_total;
+        });
+    }
+
+    benchmark("times_construction", [&] (std::int64_t count) {
+        for (std::int64_t i = 0; i < count; i++) int_total += Times(recording).static_times[Areas::Ruins];
+        sink = int_total;
+    });
+
+    RecordingReader reader(dir.string(), settings.threads);
+    benchmark("read_file", [&] (std::int64_t count) {
+        for (std::int64_t i = 0; i < count; i++) int_total += reader.read_file(recording_path).size();
+        sink = int_total;
+    });
+
+    // a spread of times like the ones of a full run
+    vector<int> values(1 << 16);
+    for (int& value : values) {
+        value = 60000 + (int) (rng.random_number() * rng.random_number() * 10000);
+    }
+    benchmark("distribution/add_value", [&] (std::int64_t count) {
+        ProbabilityDistribution dist(1);
+        for (std::int64_t i = 0; i < count; i++) dist.add_value(values[i & (values.size() - 1)]);
+        sink = dist.get_samples();
+    });
+    ProbabilityDistribution dist(1);
+    for (int value : values) {
+        dist.add_value(value);
+    }
+    benchmark("distribution/get_chance", [&] (std::int64_t count) {
+        for (std::int64_t i = 0; i < count; i++) {
+            int min = values[i & (values.size() - 1)];
+            total += dist.get_chance(min, min + 900);
+        }
+        sink = total;
+    });
+    benchmark("distribution/get_percentile", [&] (std::int64_t count) {
+        for (std::int64_t i = 0; i < count; i++) int_total += dist.get_percentile((i % 999 + 1) / 1000.0);
+        sink = int_total;
+    });
+    benchmark("distribution/convolve", [&] (std::int64_t count) {
+        for (std::int64_t i = 0; i < count; i++) {
+            ProbabilityDistribution convolved = dist;
+            convolved.convolve(dist);
+            total += convolved.get_total();
+        }
+        sink = total;
+    });
+
+    // simulations per second of every simulator, on the average of the synthetic recordings
+    Times times = reader.get_average();
+    vector<pair<string, Simulator*>> simulators = {
+        { "ruins", new Ruins(times, true, 13) },
+        { "snowdin", new Snowdin(times) },
+        { "waterfall", new Waterfall(times) },
+        { "endgame", new Endgame(times) },
+        { "full", new FullGame(times) },
+    };
+    for (auto& simulator : simulators) {
+        for (bool batched : { false, true }) {
+            string name = "simulate/" + simulator.first + (batched ? "/batched" : "");
+            benchmark(name, [&] (std::int64_t count) {
+                // the full game reuses the areas of a call with the same options, so every call gets its own seed
+                ProbabilityDistribution result = simulator.second->get_dist(count, settings.threads, rng.next(), batched);
+                sink = result.get_samples();
+            }, "sample", settings.threads);
+        }
+        delete simulator.second;
+    }
+
+    fs::remove_all(dir);
+    return 0;
+}
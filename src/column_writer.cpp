@@ -0,0 +1,60 @@
+#include <stdexcept>
+#include "column_writer.hpp"
+
+// first bytes of the file, changed whenever its layout changes
+static const char column_magic[8] = { 'C', 'O', 'L', 'U', 'M', 'N', 'S', '1' };
+
+ColumnWriter::ColumnWriter (const std::string& path, std::int64_t rows_value, const std::vector<std::string>& names) :
+    file(path, std::ios::binary), rows(rows_value), columns(names.size()) {
+    if (!file) throw std::runtime_error("couldn't open \"" + path + "\" for writing");
+    std::uint32_t column_count = columns;
+    file.write(column_magic, sizeof(column_magic));
+    file.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+    file.write(reinterpret_cast<const char*>(&column_count), sizeof(column_count));
+    for (const std::string& name : names) {
+        std::uint32_t length = name.size();
+        file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        file.write(name.data(), length);
+    }
+    data_start = file.tellp();
+}
+
+// write the values of a column from `first_row` on, can be called from any thread
+void ColumnWriter::write (int column, std::int64_t first_row, const std::int32_t* values, std::int64_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    file.seekp(data_start + (column * rows + first_row) * (std::int64_t) sizeof(std::int32_t));
+    file.write(reinterpret_cast<const char*>(values), count * sizeof(std::int32_t));
+}
+
+void ColumnWriter::close () {
+    file.close();
+    if (file.fail()) throw std::runtime_error("couldn't write the columns");
+}
+
+ColumnBlock::ColumnBlock (ColumnWriter& writer_value, int columns, std::int64_t first_row_value) :
+    writer(writer_value), values(columns), first_row(first_row_value) {
+    for (auto& column : values) {
+        column.reserve(ColumnWriter::block_rows);
+    }
+}
+
+ColumnBlock::~ColumnBlock () {
+    flush();
+}
+
+void ColumnBlock::add (const std::int32_t* row) {
+    for (std::size_t column = 0; column < values.size(); column++) {
+        values[column].push_back(row[column]);
+    }
+    if (values[0].size() == ColumnWriter::block_rows) flush();
+}
+
+void ColumnBlock::flush () {
+    std::int64_t count = values[0].size();
+    if (count == 0) return;
+    for (std::size_t column = 0; column < values.size(); column++) {
+        writer.write(column, first_row, values[column].data(), count);
+        values[column].clear();
+    }
+    first_row += count;
+}
\ No newline at end of file
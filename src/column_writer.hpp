@@ -0,0 +1,50 @@
+#ifndef COLUMN_WRITER_H
+#define COLUMN_WRITER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <mutex>
+
+// writes a table of 32 bit integers to a binary file column by column, for reading the columns as arrays elsewhere
+// the file is a header with the number of rows and the name of every column, followed by the values of each column
+// in order, so the rows can be written in any order and by several threads, in blocks that are kept in memory first
+class ColumnWriter {
+    std::ofstream file;
+    std::int64_t rows;
+    int columns;
+    // where the values of the first column start
+    std::int64_t data_start;
+    std::mutex mutex;
+
+public:
+    // rows of a block, each block is one write per column
+    static const int block_rows = 1 << 16;
+
+    ColumnWriter (const std::string& path, std::int64_t rows_value, const std::vector<std::string>& names);
+
+    void write (int column, std::int64_t first_row, const std::int32_t* values, std::int64_t count);
+
+    void close ();
+};
+
+// the rows of a writer given to one thread, kept until a block is full
+class ColumnBlock {
+    ColumnWriter& writer;
+    std::vector<std::vector<std::int32_t>> values;
+    // row of the file the block starts at
+    std::int64_t first_row;
+
+public:
+    ColumnBlock (ColumnWriter& writer_value, int columns, std::int64_t first_row_value);
+
+    ~ColumnBlock ();
+
+    // the values of a row, with one value for every column
+    void add (const std::int32_t* row);
+
+    void flush ();
+};
+
+#endif
\ No newline at end of file
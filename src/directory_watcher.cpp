@@ -0,0 +1,83 @@
+#include <filesystem>
+#include <set>
+#include <thread>
+#include <chrono>
+#include "directory_watcher.hpp"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// time without events after the first one before the files are given, since a recording is written in several steps
+static const int settle_milliseconds = 250;
+
+DirectoryWatcher::DirectoryWatcher (std::string dir_path) : dir(dir_path), notify(-1) {
+#ifdef __linux__
+    notify = inotify_init1(IN_CLOEXEC);
+    if (notify != -1 && inotify_add_watch(notify, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) == -1) {
+        close(notify);
+        notify = -1;
+    }
+#endif
+    if (notify == -1) listing = list();
+}
+
+DirectoryWatcher::~DirectoryWatcher () {
+#ifdef __linux__
+    if (notify != -1) close(notify);
+#endif
+}
+
+std::map<std::string, std::pair<std::uint64_t, std::int64_t>> DirectoryWatcher::list () {
+    std::map<std::string, std::pair<std::uint64_t, std::int64_t>> files;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(dir, error)) {
+        std::error_code entry_error;
+        if (!entry.is_regular_file(entry_error)) continue;
+        std::uint64_t size = entry.file_size(entry_error);
+        std::int64_t modified = entry.last_write_time(entry_error).time_since_epoch().count();
+        if (!entry_error) files[entry.path().filename().string()] = { size, modified };
+    }
+    return files;
+}
+
+// block until some files change, and give their names (the removed ones included)
+std::vector<std::string> DirectoryWatcher::wait () {
+    std::set<std::string> changed;
+#ifdef __linux__
+    if (notify != -1) {
+        alignas(inotify_event) char buffer[4096];
+        pollfd descriptor = { notify, POLLIN, 0 };
+        // after the first event, keep reading until the directory settles
+        int timeout = -1;
+        while (poll(&descriptor, 1, timeout) > 0) {
+            ssize_t length = read(notify, buffer, sizeof(buffer));
+            if (length <= 0) break;
+            for (char* pos = buffer; pos < buffer + length;) {
+                inotify_event* event = reinterpret_cast<inotify_event*>(pos);
+                if (event->len > 0) changed.insert(event->name);
+                pos += sizeof(inotify_event) + event->len;
+            }
+            timeout = settle_milliseconds;
+        }
+        return std::vector<std::string>(changed.begin(), changed.end());
+    }
+#endif
+    while (changed.empty()) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        auto files = list();
+        for (const auto& file : files) {
+            auto previous = listing.find(file.first);
+            if (previous == listing.end() || previous->second != file.second) changed.insert(file.first);
+        }
+        for (const auto& file : listing) {
+            if (!files.count(file.first)) changed.insert(file.first);
+        }
+        listing = files;
+    }
+    return std::vector<std::string>(changed.begin(), changed.end());
+}
\ No newline at end of file
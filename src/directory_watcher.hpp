@@ -0,0 +1,33 @@
+#ifndef DIRECTORY_WATCHER_H
+#define DIRECTORY_WATCHER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+
+// waits for files of a directory to be added, changed or removed
+// uses inotify where it's available, and otherwise compares listings of the directory every second
+class DirectoryWatcher {
+    std::string dir;
+    // inotify instance, -1 if polling
+    int notify;
+
+    // size and modification time of every file in the last listing, when polling
+    std::map<std::string, std::pair<std::uint64_t, std::int64_t>> listing;
+
+    std::map<std::string, std::pair<std::uint64_t, std::int64_t>> list ();
+
+public:
+    DirectoryWatcher (std::string dir_path);
+
+    ~DirectoryWatcher ();
+
+    DirectoryWatcher (const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator= (const DirectoryWatcher&) = delete;
+
+    std::vector<std::string> wait ();
+};
+
+#endif
\ No newline at end of file
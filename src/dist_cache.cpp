@@ -0,0 +1,101 @@
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include "dist_cache.hpp"
+
+namespace fs = std::filesystem;
+
+const char* const DistCache::file_name = "distributions.cache";
+
+// first bytes of the file, changed whenever its layout changes
+static const char cache_magic[8] = { 'D', 'I', 'S', 'T', 'C', 'H', '0', '1' };
+
+DistCache::DistCache (std::string dir, bool any_seed_value) : path((fs::path(dir) / file_name).string()), any_seed(any_seed_value) {
+    load();
+}
+
+// read the stored distributions, ignoring the file if it's cut or corrupted
+void DistCache::load () {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return;
+    std::string buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const char* pos = buffer.data();
+    const char* end = pos + buffer.size();
+
+    std::uint32_t count;
+    if (buffer.size() < sizeof(cache_magic) + sizeof(count) || !std::equal(cache_magic, cache_magic + sizeof(cache_magic), pos)) return;
+    pos += sizeof(cache_magic);
+    std::copy(pos, pos + sizeof(count), reinterpret_cast<char*>(&count));
+    pos += sizeof(count);
+
+    std::vector<Entry> read_entries;
+    for (std::uint32_t i = 0; i < count; i++) {
+        Entry entry = { 0, ProbabilityDistribution(1) };
+        if ((std::size_t) (end - pos) < sizeof(entry.key)) return;
+        std::copy(pos, pos + sizeof(entry.key), reinterpret_cast<char*>(&entry.key));
+        pos += sizeof(entry.key);
+        if (!entry.dist.read(pos, end)) return;
+        read_entries.push_back(std::move(entry));
+    }
+    entries = std::move(read_entries);
+}
+
+// written to a temporary file first, so a run stopped while writing leaves the last complete file
+void DistCache::save () {
+    std::string buffer(cache_magic, sizeof(cache_magic));
+    std::uint32_t count = entries.size();
+    buffer.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const Entry& entry : entries) {
+        buffer.append(reinterpret_cast<const char*>(&entry.key), sizeof(entry.key));
+        entry.dist.write(buffer);
+    }
+
+    std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary);
+        if (!file) return;
+        file.write(buffer.data(), buffer.size());
+        if (!file) return;
+    }
+    std::error_code error;
+    fs::rename(temporary_path, path, error);
+    if (error) fs::remove(temporary_path, error);
+}
+
+// distribution of at least `simulations` from `simulate`, which is only called for the ones that aren't stored
+// `simulator_key` has to change with anything that changes the results of the simulator (see `Simulator::get_cache_key`)
+ProbabilityDistribution DistCache::get (
+    const std::string& simulator_key, std::int64_t simulations, int threads, std::uint64_t seed, bool batched,
+    const std::function<ProbabilityDistribution (std::int64_t simulations, std::uint64_t seed)>& simulate
+) {
+    std::string text = simulator_key + (batched ? " batched" : "");
+    if (!any_seed) text += " " + std::to_string(seed) + " " + std::to_string(threads);
+    // FNV-1a
+    std::uint64_t key = 14695981039346656037ull;
+    for (char c : text) {
+        key ^= (unsigned char) c;
+        key *= 1099511628211ull;
+    }
+
+    auto found = std::find_if(entries.begin(), entries.end(), [key] (const Entry& entry) { return entry.key == key; });
+    Entry entry = { key, ProbabilityDistribution(1) };
+    if (found != entries.end()) {
+        entry = std::move(*found);
+        entries.erase(found);
+    }
+
+    std::int64_t stored = entry.dist.get_samples();
+    bool changed = stored < simulations;
+    if (changed) {
+        // the missing simulations get a seed of their own, so they don't repeat the stored ones
+        std::uint64_t extra_seed = stored == 0 ? seed : seed + stored * 0x9e3779b97f4a7c15ull;
+        entry.dist.add(simulate(simulations - stored, extra_seed));
+    }
+    ProbabilityDistribution dist = entry.dist;
+    entries.push_back(std::move(entry));
+    if (entries.size() > max_entries) entries.erase(entries.begin());
+    // moving an entry to the back only changes which is dropped first, so the file is kept as it was
+    if (changed) save();
+    return dist;
+}
\ No newline at end of file
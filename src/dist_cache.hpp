@@ -0,0 +1,46 @@
+#ifndef DIST_CACHE_H
+#define DIST_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+#include "probability_distribution.hpp"
+
+// simulated distributions kept in a file between runs, so running the same configuration again takes no simulations
+// every distribution is stored under a hash of what it depends on: the simulator with its options and times,
+// the seed and the number of threads
+// asking for more simulations than the stored ones only simulates the missing ones and adds them
+class DistCache {
+    std::string path;
+    // without a fixed seed any stored distribution of the simulator is used, since none could be repeated anyway
+    bool any_seed;
+
+    struct Entry {
+        std::uint64_t key;
+        ProbabilityDistribution dist;
+    };
+
+    // in the order they were last used, the oldest are dropped first
+    std::vector<Entry> entries;
+
+    void load ();
+
+    void save ();
+
+public:
+    // name of the file in the recordings directory
+    static const char* const file_name;
+
+    // most distributions kept
+    static const int max_entries = 64;
+
+    DistCache (std::string dir, bool any_seed_value);
+
+    ProbabilityDistribution get (
+        const std::string& simulator_key, std::int64_t simulations, int threads, std::uint64_t seed, bool batched,
+        const std::function<ProbabilityDistribution (std::int64_t simulations, std::uint64_t seed)>& simulate
+    );
+};
+
+#endif
\ No newline at end of file
@@ -1,6 +1,11 @@
 #ifndef ENCOUNTERS_H
 #define ENCOUNTERS_H
 
+#include <cstdint>
+#include <initializer_list>
+#include "random.hpp"
+#include "probability_distribution.hpp"
+
 enum Encounters {
     SingleFroggit,
     Whimsun,
@@ -23,7 +28,124 @@ enum Encounters {
     KnightKnightMadjick,
     SingleKnightKnight,
     SingleMadjick,
-    CoreTriple
+    CoreTriple,
+    // number of encounters, for tables indexed by encounter
+    EncounterCount
+};
+
+// an encounter an encounterer can give, with its chance
+struct EncounterChance {
+    int encounter;
+    double chance;
+};
+
+// the encounters of an encounterer with their chances, in the order the game checks them
+// the thresholds are worked out at compile time, so picking an encounter is counting how many of them the roll passed,
+// with a single draw and no branches
+class EncounterTable {
+public:
+    static const int max_size = 8;
+private:
+    int size;
+    // past the size, the last encounter is repeated and the thresholds can't be passed, so every pick has the same loop
+    int encounters[max_size];
+    double chances[max_size];
+    std::uint64_t thresholds[max_size - 1];
+    // sum of the chances
+    double total;
+public:
+    constexpr EncounterTable (std::initializer_list<EncounterChance> entries) :
+        size(0), encounters(), chances(), thresholds(), total(0) {
+        for (const EncounterChance& entry : entries) {
+            // the roll passes the threshold of an encounter when it's over the chances of the ones before it
+            if (size > 0) thresholds[size - 1] = Random::threshold(total);
+            encounters[size] = entry.encounter;
+            chances[size] = entry.chance;
+            total += entry.chance;
+            size++;
+        }
+        for (int i = size; i < max_size; i++) {
+            encounters[i] = encounters[size - 1];
+            thresholds[i - 1] = UINT64_MAX;
+        }
+    }
+
+    // whether the chances add up to 1, checked for every table when compiling
+    constexpr bool is_complete () const {
+        return size > 0 && size <= max_size && total > 1 - 1e-9 && total < 1 + 1e-9;
+    }
+
+    int pick (std::uint64_t roll) const {
+        int pos = 0;
+        for (int i = 0; i < max_size - 1; i++) {
+            pos += roll >= thresholds[i];
+        }
+        return encounters[pos];
+    }
+
+    Chances get_chances () const {
+        Chances result;
+        for (int i = 0; i < size; i++) {
+            result.push_back({ encounters[i], chances[i] });
+        }
+        return result;
+    }
 };
 
+// tables of every random encounterer, a new encounterer only needs a table here
+namespace EncounterTables {
+    // first half of the ruins
+    constexpr EncounterTable ruins1 = {
+        { Encounters::SingleFroggit, 1.0 / 2 },
+        { Encounters::Whimsun, 1.0 / 2 }
+    };
+
+    // second half of the ruins (the third encounterer in the game)
+    constexpr EncounterTable ruins3 = {
+        { Encounters::FroggitWhimsun, 1.0 / 4 },
+        { Encounters::SingleMoldsmal, 1.0 / 4 },
+        { Encounters::TripleMoldsmal, 1.0 / 4 },
+        { Encounters::DoubleFroggit, 3.0 / 20 },
+        { Encounters::DoubleMoldsmal, 1.0 / 10 }
+    };
+
+    // snowdin grind
+    constexpr EncounterTable snowdin = {
+        { Encounters::SnowdinTriple, 1.0 / 2 },
+        { Encounters::SnowdinDouble, 1.0 / 2 }
+    };
+
+    // first random encounter of waterfall
+    constexpr EncounterTable glowing_water = {
+        { Encounters::SingleWoshua, 4.0 / 15 },
+        { Encounters::DoubleMoldsmal, 4.0 / 15 },
+        { Encounters::SingleAaron, 3.0 / 15 },
+        { Encounters::WoshuaAaron, 4.0 / 15 }
+    };
+
+    // end of waterfall
+    constexpr EncounterTable waterfall_grind = {
+        { Encounters::WoshuaAaron, 5.0 / 15 },
+        { Encounters::WoshuaMoldbygg, 6.0 / 15 },
+        { Encounters::Temmie, 4.0 / 15 }
+    };
+
+    constexpr EncounterTable core = {
+        { Encounters::FinalFroggitAstigmatism, 2.0 / 15 },
+        { Encounters::WhimsalotFinalFroggit, 3.0 / 15 },
+        { Encounters::WhimsalotAstigmatism, 3.0 / 15 },
+        { Encounters::KnightKnightMadjick, 3.0 / 15 },
+        { Encounters::CoreTriple, 2.0 / 15 },
+        { Encounters::SingleKnightKnight, 1.0 / 15 },
+        { Encounters::SingleMadjick, 1.0 / 15 }
+    };
+
+    static_assert(ruins1.is_complete(), "ruins1 chances don't add up to 1");
+    static_assert(ruins3.is_complete(), "ruins3 chances don't add up to 1");
+    static_assert(snowdin.is_complete(), "snowdin chances don't add up to 1");
+    static_assert(glowing_water.is_complete(), "glowing water chances don't add up to 1");
+    static_assert(waterfall_grind.is_complete(), "waterfall grind chances don't add up to 1");
+    static_assert(core.is_complete(), "core chances don't add up to 1");
+}
+
 #endif
\ No newline at end of file
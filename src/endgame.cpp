@@ -2,19 +2,30 @@
 #include "undertale.hpp"
 #include "encounters.hpp"
 
-Endgame::Endgame (Times& times_value) : Simulator(times_value) {}
+Endgame::Endgame (const Times& times_value) : Simulator(times_value) {
+    times.require(Areas::Endgame);
+}
 
-int Endgame::simulate () {
-    int time = times.segments["endgame"];
-    time += Undertale::encounter_time_random(times.static_blcons["endgame"]);
+Simulator* Endgame::clone (const Times& times_value) {
+    return new Endgame(times_value);
+}
+
+std::string Endgame::get_cache_key () {
+    return get_area_key(Areas::Endgame);
+}
+
+template <typename Rng>
+int Endgame::simulate_draws (Rng& rng, SampleContext& context) {
+    int time = use_static_time(context, Areas::Endgame);
+    time += Undertale::encounter_time_random(rng, context, times.static_blcons[Areas::Endgame]);
     
     // scripted encounter step count
     int kills = 5;
-    time += Undertale::core_steps(kills);
+    time += Undertale::core_steps(rng, context, kills);
     
     kills = 6;
     while (kills < 14) {
-        time += Undertale::core_steps(kills);
+        time += Undertale::core_steps(rng, context, kills);
         kills += 2;
     }
 
@@ -22,7 +33,7 @@ int Endgame::simulate () {
     bool went_left = false;
     while (kills < 40) {
         if (kills < 27) {
-            time += times.segments["core-right-transition"];
+            time += use_segment(context, Segments::CoreRightTransition);
         } else if (!went_left) {
             went_left = true;
         } else {
@@ -30,18 +41,18 @@ int Endgame::simulate () {
             if (kills >= 32) kills += 7;
             // if ending it here, it means we did warrior path and then finished: get the nobody cames and such
             if (kills >= 40) {
-                time += 4 * times.segments["nobody-came"];
-                time += Undertale::encounter_time_random(4);
-                time += times.segments["core-bridge"];
+                time += use_segment(context, Segments::NobodyCame, 4);
+                time += Undertale::encounter_time_random(rng, context, 4);
+                time += use_segment(context, Segments::CoreBridge);
                 break;
             }
             // grind an encounter at 39 in the bridge after coming back
-            if (kills == 39) time += times.segments["grind-end-transition"];
+            if (kills == 39) time += use_segment(context, Segments::GrindEndTransition);
             // grinding in the left side
-            else time += times.segments["core-left-side-transition-2"] + times.segments["core-left-side-transition-3"];
+            else time += use_segment(context, Segments::CoreLeftSideTransition2) + use_segment(context, Segments::CoreLeftSideTransition3);
         }
-        int steps = Undertale::core_steps(kills);
-        int encounter = Undertale::core_encounter();
+        int steps = Undertale::core_steps(rng, context, kills);
+        int encounter = Undertale::core_encounter(rng, context);
 
         bool flee_one = kills == 39;
         if (
@@ -52,11 +63,11 @@ int Endgame::simulate () {
         ) {
             kills += 2;
             if (encounter == Encounters::FinalFroggitAstigmatism) {
-                time += flee_one ? times.segments["frog-astig-flee"] : times.segments["frog-astig"];
+                time += flee_one ? use_segment(context, Segments::FrogAstigFlee) : use_segment(context, Segments::FrogAstig);
             } else if (encounter == Encounters::WhimsalotAstigmatism) {
-                time += flee_one ? times.segments["whim-astig-flee"] : times.segments["whim-astig"];
+                time += flee_one ? use_segment(context, Segments::WhimAstigFlee) : use_segment(context, Segments::WhimAstig);
             } else {
-                time += flee_one ? times.segments["core-frog-whim-flee"] : times.segments["core-frog-whim"];
+                time += flee_one ? use_segment(context, Segments::CoreFrogWhimFlee) : use_segment(context, Segments::CoreFrogWhim);
             }
         } else if (
             encounter == Encounters::SingleKnightKnight ||
@@ -64,24 +75,227 @@ int Endgame::simulate () {
         ) {
             kills++;
             if (encounter == Encounters::SingleKnightKnight) {
-                time += times.segments["sgl-knight"];
+                time += use_segment(context, Segments::SglKnight);
             } else {
-                time += times.segments["sgl-madjick"];
+                time += use_segment(context, Segments::SglMadjick);
             }
         } else {
             if (flee_one) {
-                time += times.segments["core-triple-kill-one"];
+                time += use_segment(context, Segments::CoreTripleKillOne);
             } else if (kills == 31) {
-                time += times.segments["core-triple-kill-two"];
+                time += use_segment(context, Segments::CoreTripleKillTwo);
             } else {
-                time += times.segments["core-triple"];
+                time += use_segment(context, Segments::CoreTriple);
             }
             kills += 3;
         }
 
         time += steps;
-        time += Undertale::encounter_time_random();
+        time += Undertale::encounter_time_random(rng, context);
     }
 
     return time;
+}
+
+int Endgame::simulate (Random& rng, SampleContext& context) {
+    return simulate_draws(rng, context);
+}
+
+int Endgame::simulate (QuasiRandom& rng, SampleContext& context) {
+    return simulate_draws(rng, context);
+}
+
+// same simulation as `simulate`, running all the lanes in lockstep
+void Endgame::simulate_batch (RandomLanes& lanes, int* results) {
+    const int size = RandomLanes::size;
+    alignas(64) int time[size];
+    alignas(64) int kills[size];
+    alignas(64) int steps[size];
+    alignas(64) int blcons[size];
+    alignas(64) int encounters[size];
+    alignas(64) int before_steps[size];
+    alignas(64) bool went_left[size];
+    alignas(64) bool active[size];
+    alignas(64) bool warrior_path_end[size];
+
+    // segments are read once for the whole batch
+    int right_transition = times.segments[Segments::CoreRightTransition];
+    int left_transition = times.segments[Segments::CoreLeftSideTransition2] + times.segments[Segments::CoreLeftSideTransition3];
+    int grind_end_transition = times.segments[Segments::GrindEndTransition];
+
+    // tables for the encounters, the columns being the general case, fleeing at 39 kills and having 31 kills
+    int encounter_times[Encounters::EncounterCount][3] = {};
+    int encounter_kills[Encounters::EncounterCount] = {};
+    int frog_astig[3] = { times.segments[Segments::FrogAstig], times.segments[Segments::FrogAstigFlee], times.segments[Segments::FrogAstig] };
+    int whim_astig[3] = { times.segments[Segments::WhimAstig], times.segments[Segments::WhimAstigFlee], times.segments[Segments::WhimAstig] };
+    int frog_whim[3] = { times.segments[Segments::CoreFrogWhim], times.segments[Segments::CoreFrogWhimFlee], times.segments[Segments::CoreFrogWhim] };
+    int triple[3] = { times.segments[Segments::CoreTriple], times.segments[Segments::CoreTripleKillOne], times.segments[Segments::CoreTripleKillTwo] };
+    for (int column = 0; column < 3; column++) {
+        encounter_times[Encounters::FinalFroggitAstigmatism][column] = frog_astig[column];
+        encounter_times[Encounters::WhimsalotAstigmatism][column] = whim_astig[column];
+        encounter_times[Encounters::WhimsalotFinalFroggit][column] = frog_whim[column];
+        encounter_times[Encounters::KnightKnightMadjick][column] = frog_whim[column];
+        encounter_times[Encounters::SingleKnightKnight][column] = times.segments[Segments::SglKnight];
+        encounter_times[Encounters::SingleMadjick][column] = times.segments[Segments::SglMadjick];
+        encounter_times[Encounters::CoreTriple][column] = triple[column];
+    }
+    encounter_kills[Encounters::FinalFroggitAstigmatism] = 2;
+    encounter_kills[Encounters::WhimsalotAstigmatism] = 2;
+    encounter_kills[Encounters::WhimsalotFinalFroggit] = 2;
+    encounter_kills[Encounters::KnightKnightMadjick] = 2;
+    encounter_kills[Encounters::SingleKnightKnight] = 1;
+    encounter_kills[Encounters::SingleMadjick] = 1;
+    encounter_kills[Encounters::CoreTriple] = 3;
+
+    Undertale::encounter_time_random(lanes, times.static_blcons[Areas::Endgame], time);
+    for (int lane = 0; lane < size; lane++) {
+        time[lane] += times.static_times[Areas::Endgame];
+        went_left[lane] = false;
+        active[lane] = true;
+        warrior_path_end[lane] = false;
+    }
+
+    // scripted encounters, the same kills in every lane
+    for (int scripted_kills : { 5, 6, 8, 10, 12 }) {
+        for (int lane = 0; lane < size; lane++) kills[lane] = scripted_kills;
+        Undertale::scr_steps(lanes, 70, 50, 40, kills, steps);
+        for (int lane = 0; lane < size; lane++) time[lane] += steps[lane];
+    }
+    for (int lane = 0; lane < size; lane++) kills[lane] = 14;
+
+    // lanes that reach 40 kills are masked off until all of them are done
+    bool any_active = true;
+    while (any_active) {
+        // the room transitions come before the steps since the warrior path changes the kills used by the steps
+        #pragma omp simd
+        for (int lane = 0; lane < size; lane++) {
+            int transition = 0;
+            if (kills[lane] < 27) {
+                transition = right_transition;
+            } else if (!went_left[lane]) {
+                went_left[lane] = active[lane];
+            } else {
+                // warriors path
+                int path_kills = kills[lane] >= 32 ? kills[lane] + 7 : kills[lane];
+                bool ending = active[lane] && path_kills >= 40;
+                warrior_path_end[lane] = warrior_path_end[lane] || ending;
+                kills[lane] = active[lane] ? path_kills : kills[lane];
+                active[lane] = active[lane] && !ending;
+                // grind an encounter at 39 in the bridge after coming back, else grind in the left side
+                transition = kills[lane] == 39 ? grind_end_transition : left_transition;
+            }
+            before_steps[lane] = transition;
+        }
+
+        Undertale::scr_steps(lanes, 70, 50, 40, kills, steps);
+        Undertale::core_encounter(lanes, encounters);
+        Undertale::encounter_time_random(lanes, 1, blcons);
+
+        any_active = false;
+        #pragma omp simd
+        for (int lane = 0; lane < size; lane++) {
+            int column = kills[lane] == 39 ? 1 : (kills[lane] == 31 ? 2 : 0);
+            int encounter = encounters[lane];
+            int encounter_time = before_steps[lane] + steps[lane] + encounter_times[encounter][column] + blcons[lane];
+            time[lane] += active[lane] ? encounter_time : 0;
+            kills[lane] += active[lane] ? encounter_kills[encounter] : 0;
+            active[lane] = active[lane] && kills[lane] < 40;
+        }
+        for (int lane = 0; lane < size; lane++) {
+            any_active = any_active || active[lane];
+        }
+    }
+
+    // if ending with the warrior path, get the nobody cames and such
+    Undertale::encounter_time_random(lanes, 4, blcons);
+    int warrior_path_time = 4 * times.segments[Segments::NobodyCame] + times.segments[Segments::CoreBridge];
+    for (int lane = 0; lane < size; lane++) {
+        results[lane] = time[lane] + (warrior_path_end[lane] ? warrior_path_time + blcons[lane] : 0);
+    }
+}
+
+// same as `simulate`, but following every branch with its chance to get the exact distribution
+// tracking the kills and whether the buffer round before the left side happened
+ProbabilityDistribution Endgame::get_exact_dist () {
+    ProbabilityDistribution time = Undertale::encounter_time_chances(times.static_blcons[Areas::Endgame]);
+    time.shift(times.static_times[Areas::Endgame]);
+
+    // scripted encounter step count
+    time.convolve(ProbabilityDistribution(Undertale::core_steps_chances(5)));
+    for (int kills = 6; kills < 14; kills += 2) {
+        time.convolve(ProbabilityDistribution(Undertale::core_steps_chances(kills)));
+    }
+
+    std::map<std::pair<int, bool>, ProbabilityDistribution> states;
+    states.emplace(std::make_pair(14, false), time);
+    ProbabilityDistribution result(1);
+    for (const auto& [state, dist] : states) {
+        auto [kills, went_left] = state;
+        if (kills >= 40) {
+            result.add(dist);
+            continue;
+        }
+
+        ProbabilityDistribution walked = dist;
+        if (kills < 27) {
+            walked.shift(times.segments[Segments::CoreRightTransition]);
+        } else if (!went_left) {
+            went_left = true;
+        } else {
+            // warriors path
+            if (kills >= 32) kills += 7;
+            // if ending it here, it means we did warrior path and then finished: get the nobody cames and such
+            if (kills >= 40) {
+                walked.shift(4 * times.segments[Segments::NobodyCame] + times.segments[Segments::CoreBridge]);
+                walked.convolve(Undertale::encounter_time_chances(4));
+                result.add(walked);
+                continue;
+            }
+            // grind an encounter at 39 in the bridge after coming back
+            if (kills == 39) walked.shift(times.segments[Segments::GrindEndTransition]);
+            // grinding in the left side
+            else walked.shift(times.segments[Segments::CoreLeftSideTransition2] + times.segments[Segments::CoreLeftSideTransition3]);
+        }
+        walked.convolve(ProbabilityDistribution(Undertale::core_steps_chances(kills)));
+        walked.convolve(Undertale::encounter_time_chances(1));
+
+        bool flee_one = kills == 39;
+        for (const auto& encounter : Undertale::core_encounter_chances()) {
+            ProbabilityDistribution branch = walked;
+            int encounter_kills;
+            if (
+                encounter.first == Encounters::FinalFroggitAstigmatism ||
+                encounter.first == Encounters::WhimsalotAstigmatism ||
+                encounter.first == Encounters::WhimsalotFinalFroggit ||
+                encounter.first == Encounters::KnightKnightMadjick
+            ) {
+                encounter_kills = 2;
+                if (encounter.first == Encounters::FinalFroggitAstigmatism) {
+                    branch.shift(flee_one ? times.segments[Segments::FrogAstigFlee] : times.segments[Segments::FrogAstig]);
+                } else if (encounter.first == Encounters::WhimsalotAstigmatism) {
+                    branch.shift(flee_one ? times.segments[Segments::WhimAstigFlee] : times.segments[Segments::WhimAstig]);
+                } else {
+                    branch.shift(flee_one ? times.segments[Segments::CoreFrogWhimFlee] : times.segments[Segments::CoreFrogWhim]);
+                }
+            } else if (
+                encounter.first == Encounters::SingleKnightKnight ||
+                encounter.first == Encounters::SingleMadjick
+            ) {
+                encounter_kills = 1;
+                branch.shift(encounter.first == Encounters::SingleKnightKnight ? times.segments[Segments::SglKnight] : times.segments[Segments::SglMadjick]);
+            } else {
+                if (flee_one) {
+                    branch.shift(times.segments[Segments::CoreTripleKillOne]);
+                } else if (kills == 31) {
+                    branch.shift(times.segments[Segments::CoreTripleKillTwo]);
+                } else {
+                    branch.shift(times.segments[Segments::CoreTriple]);
+                }
+                encounter_kills = 3;
+            }
+            branch.scale(encounter.second);
+            add_state(states, { kills + encounter_kills, went_left }, branch);
+        }
+    }
+    return result;
 }
\ No newline at end of file
@@ -6,9 +6,23 @@
 // Class for the Hotland/Core/Post core simulator
 class Endgame : public Simulator {
 public:
-    Endgame (Times& times_value);
+    Endgame (const Times& times_value);
 
-    int simulate() override;
+    int simulate (Random& rng, SampleContext& context) override;
+
+    int simulate (QuasiRandom& rng, SampleContext& context) override;
+
+    void simulate_batch (RandomLanes& lanes, int* results) override;
+
+    ProbabilityDistribution get_exact_dist () override;
+
+    Simulator* clone (const Times& times_value) override;
+
+    std::string get_cache_key () override;
+
+private:
+    template <typename Rng>
+    int simulate_draws (Rng& rng, SampleContext& context);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include <cmath>
+#include <map>
+#include <algorithm>
+#include "execution_times.hpp"
+
+AliasTable::AliasTable () : start(0) {}
+
+// table for the values of `dist` from `min` to `max`
+AliasTable::AliasTable (ProbabilityDistribution& dist, int min, int max) : start(min), keep(max - min + 1), alias(max - min + 1) {
+    int size = keep.size();
+    // slots with less than the average weight are filled up by the ones with more
+    std::vector<int> small;
+    std::vector<int> large;
+    for (int i = 0; i < size; i++) {
+        keep[i] = dist.get_chance(min + i, min + i + 1) * size;
+        alias[i] = i;
+        if (keep[i] < 1) small.push_back(i);
+        else large.push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+        int low = small.back();
+        small.pop_back();
+        int high = large.back();
+        alias[low] = high;
+        keep[high] -= 1 - keep[low];
+        if (keep[high] < 1) {
+            large.pop_back();
+            small.push_back(high);
+        }
+    }
+    // what is left is 1 up to rounding
+    for (int i : small) keep[i] = 1;
+    for (int i : large) keep[i] = 1;
+}
+
+bool AliasTable::empty () const {
+    return keep.empty();
+}
+
+int AliasTable::draw (Random& rng) const {
+    std::uint64_t bits = rng.next();
+    // the top 32 bits pick the slot and the bottom 32 bits decide between it and its alias
+    int slot = ((bits >> 32) * keep.size()) >> 32;
+    double u = (double) (bits & 0xffffffff) * 0x1.0p-32;
+    return start + (u < keep[slot] ? slot : alias[slot]);
+}
+
+// the fields a segment can change: `segments`, then both elements of `steps`, then `static_times`
+static const int field_count = Segments::Count * 3 + Areas::Count;
+
+int& ExecutionTimes::field (Times& times, int index) {
+    if (index < Segments::Count) return times.segments[index];
+    index -= Segments::Count;
+    if (index < Segments::Count * 2) return times.steps[index / 2][index % 2];
+    return times.static_times[index - Segments::Count * 2];
+}
+
+// area whose times a field is part of
+// the segments without an area are the route choices of the ruins, like in `Times::area_hash`
+static int field_area (int index) {
+    if (index >= Segments::Count * 3) return index - Segments::Count * 3;
+    int segment = index < Segments::Count ? index : (index - Segments::Count) / 2;
+    int area = segment_info[segment].area;
+    return area == Areas::None ? Areas::Ruins : area;
+}
+
+ExecutionTimes::ExecutionTimes (const std::vector<std::unordered_map<std::string, int>>& recordings) {
+    // the average of every segment over the recordings that have it
+    // (sorted by name, so the draws happen in the same order everywhere)
+    std::map<std::string, std::vector<int>> values;
+    for (const auto& recording : recordings) {
+        for (const auto& pair : recording) {
+            values[pair.first].push_back(pair.second);
+        }
+    }
+    std::unordered_map<std::string, int> average_map;
+    for (const auto& pair : values) {
+        double total = 0;
+        for (int value : pair.second) total += value;
+        average_map[pair.first] = static_cast<int>(std::round(total / pair.second.size()));
+    }
+    average = Times(average_map);
+
+    // distribution of the total of the static-only deviations of every area, with its range
+    std::vector<ProbabilityDistribution> static_totals(Areas::Count, ProbabilityDistribution(Chances{ { 0, 1.0 } }));
+    int static_min[Areas::Count] = {};
+    int static_max[Areas::Count] = {};
+
+    for (const auto& pair : values) {
+        Source source;
+        source.areas = 0;
+        bool varies = false;
+        for (int value : pair.second) {
+            source.deviations.push_back(value - average_map[pair.first]);
+            varies = varies || value != pair.second[0];
+        }
+        if (!varies) continue;
+
+        // what one more frame of the segment changes
+        std::unordered_map<std::string, int> shifted_map = average_map;
+        shifted_map[pair.first]++;
+        Times shifted(shifted_map);
+        for (int index = 0; index < field_count; index++) {
+            int effect = field(shifted, index) - field(average, index);
+            if (effect != 0) {
+                source.effects.push_back({ index, effect });
+                source.areas |= 1u << field_area(index);
+            }
+        }
+        if (source.effects.empty()) continue;
+
+        // segments that only change a static time
+        int first = source.effects[0].first;
+        if (source.effects.size() == 1 && first >= Segments::Count * 3) {
+            int area = first - Segments::Count * 3;
+            int effect = source.effects[0].second;
+            Chances chances;
+            int low = 0;
+            int high = 0;
+            for (int deviation : source.deviations) {
+                chances.push_back({ effect * deviation, 1.0 / source.deviations.size() });
+                low = std::min(low, effect * deviation);
+                high = std::max(high, effect * deviation);
+            }
+            static_totals[area].convolve(ProbabilityDistribution(chances));
+            static_min[area] += low;
+            static_max[area] += high;
+        }
+        else sources.push_back(source);
+    }
+
+    for (int area = 0; area < Areas::Count; area++) {
+        if (static_min[area] != static_max[area]) {
+            static_deviations[area] = AliasTable(static_totals[area], static_min[area], static_max[area]);
+        }
+    }
+}
+
+// copy with only the segments that change the times of `area`, which is all an area simulator needs to draw
+ExecutionTimes ExecutionTimes::for_area (int area) const {
+    ExecutionTimes result = *this;
+    result.sources.clear();
+    for (int other = 0; other < Areas::Count; other++) {
+        if (other != area) result.static_deviations[other] = AliasTable();
+    }
+    for (const Source& source : sources) {
+        if (source.areas >> area & 1) result.sources.push_back(source);
+    }
+    return result;
+}
+
+// overwrite `out` with the average times plus a recorded deviation of every segment
+void ExecutionTimes::draw (Random& rng, Times& out) const {
+    out = average;
+    for (int area = 0; area < Areas::Count; area++) {
+        if (!static_deviations[area].empty()) out.static_times[area] += static_deviations[area].draw(rng);
+    }
+    for (const Source& source : sources) {
+        // uniform index from the top 32 bits, without a division
+        std::uint64_t pick = ((rng.next() >> 32) * source.deviations.size()) >> 32;
+        int deviation = source.deviations[pick];
+        for (const auto& effect : source.effects) {
+            field(out, effect.first) += effect.second * deviation;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef EXECUTION_TIMES_H
+#define EXECUTION_TIMES_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "times.hpp"
+#include "random.hpp"
+#include "probability_distribution.hpp"
+
+// table to draw from a discrete distribution in constant time (Vose's alias method)
+// every slot is picked uniformly, and then gives either its own value or its alias
+class AliasTable {
+    // value of the first slot
+    int start;
+    // chance of keeping the slot's own value
+    std::vector<double> keep;
+    std::vector<int> alias;
+public:
+    AliasTable ();
+
+    AliasTable (ProbabilityDistribution& dist, int min, int max);
+
+    bool empty () const;
+
+    int draw (Random& rng) const;
+};
+
+// keeps every recorded value of the segments, to draw the times of each simulation from them (execution variance)
+// instead of using the same times for all of them
+// `Times` is a sum of the named segments, so the recorded values are stored as their difference to the average,
+// together with what one frame of each named segment adds to the fields of `Times`
+class ExecutionTimes {
+    // a named segment that wasn't always the same in the recordings
+    struct Source {
+        // recorded values minus the average, one per recording it appears in, so a uniform pick is a draw
+        std::vector<int> deviations;
+        // (field, frames added per frame of the segment), for the fields numbered by `field`
+        std::vector<std::pair<int, int>> effects;
+        // bit of every area whose times it changes
+        unsigned areas;
+    };
+
+    static int& field (Times& times, int index);
+
+    // segments that only add to the static time of an area are drawn together, as the total of their deviations,
+    // which has the convolution of their distributions
+    AliasTable static_deviations[Areas::Count];
+
+    // every other segment is drawn on its own
+    std::vector<Source> sources;
+public:
+    // times with the average of every segment
+    Times average;
+
+    ExecutionTimes (const std::vector<std::unordered_map<std::string, int>>& recordings);
+
+    ExecutionTimes for_area (int area) const;
+
+    void draw (Random& rng, Times& out) const;
+};
+
+#endif
\ No newline at end of file
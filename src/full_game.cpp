@@ -1,20 +1,126 @@
+#include <type_traits>
 #include "full_game.hpp"
 #include "ruins.hpp"
 #include "snowdin.hpp"
 #include "waterfall.hpp"
 #include "endgame.hpp"
+#include "sobol.hpp"
 
-FullGame::FullGame (Times& times_value) : Simulator (times_value) {
+FullGame::FullGame (const Times& times_value) : Simulator (times_value), area_dists(area_count, ProbabilityDistribution(1)) {
+    for (int i = 0; i < area_count; i++) {
+        area_cached[i] = false;
+    }
     children[0] = new Ruins(times_value, false, 13);
     children[1] = new Snowdin(times_value);
     children[2] = new Waterfall(times_value);
     children[3] = new Endgame(times_value);
 }
 
-int FullGame::simulate () {
+FullGame::~FullGame () {
+    for (int i = 0; i < area_count; i++) {
+        delete children[i];
+    }
+}
+
+Simulator* FullGame::clone (const Times& times_value) {
+    return new FullGame(times_value);
+}
+
+template <typename Rng>
+int FullGame::simulate_draws (Rng& rng, SampleContext& context) {
+    int time = 0;
+    for (int i = 0; i < area_count; i++) {
+        // with quasi-random draws, every area has its own dimensions
+        if constexpr (std::is_same_v<Rng, QuasiRandom>) {
+            rng.use_dimensions(i * Sobol::dimensions / area_count, (i + 1) * Sobol::dimensions / area_count);
+        }
+        time += children[i]->simulate(rng, context);
+    }
+    return time;
+}
+
+int FullGame::simulate (Random& rng, SampleContext& context) {
+    return simulate_draws(rng, context);
+}
+
+int FullGame::simulate (QuasiRandom& rng, SampleContext& context) {
+    return simulate_draws(rng, context);
+}
+
+// the parts are the areas
+std::vector<std::string> FullGame::get_parts () {
+    return std::vector<std::string>(area_names, area_names + area_count);
+}
+
+int FullGame::simulate_parts (Random& rng, SampleContext& context, int* part_times, std::int64_t* part_encounters) {
     int time = 0;
     for (int i = 0; i < area_count; i++) {
-        time += children[i]->simulate();
+        std::int64_t encounters = context.encounters;
+        part_times[i] = children[i]->simulate(rng, context);
+        part_encounters[i] = context.encounters - encounters;
+        time += part_times[i];
     }
     return time;
+}
+
+void FullGame::simulate_batch (RandomLanes& lanes, int* results) {
+    int area_results[RandomLanes::size];
+    for (int lane = 0; lane < RandomLanes::size; lane++) {
+        results[lane] = 0;
+    }
+    for (int i = 0; i < area_count; i++) {
+        children[i]->simulate_batch(lanes, area_results);
+        for (int lane = 0; lane < RandomLanes::size; lane++) {
+            results[lane] += area_results[lane];
+        }
+    }
+}
+
+// the areas share no random state, so the distribution of the full game is the convolution of the area distributions
+// each area is only redone if its times or the options changed since the last query
+ProbabilityDistribution FullGame::combine_areas (AreaKey options, const std::function<ProbabilityDistribution (int)>& get_area) {
+    ProbabilityDistribution dist(1);
+    for (int i = 0; i < area_count; i++) {
+        AreaKey key = options;
+        std::get<0>(key) = times.area_hash(i);
+        if (!area_cached[i] || area_keys[i] != key) {
+            area_dists[i] = get_area(i);
+            area_keys[i] = key;
+            area_cached[i] = true;
+        }
+        if (i == 0) dist = area_dists[i];
+        else dist.convolve(area_dists[i]);
+    }
+    return dist;
+}
+
+// `simulations` are run for each area, and every area gets its own seed from `seed`
+ProbabilityDistribution FullGame::get_dist (std::int64_t simulations, int threads, std::uint64_t seed, bool batched) {
+    std::uint64_t area_seeds[area_count];
+    Random seeds(seed);
+    for (int i = 0; i < area_count; i++) {
+        area_seeds[i] = seeds.next();
+    }
+
+    // every area only draws the segments it reads
+    std::vector<ExecutionTimes> area_executions;
+    if (execution) {
+        for (int i = 0; i < area_count; i++) {
+            area_executions.push_back(execution->for_area(i));
+        }
+    }
+
+    return combine_areas({ 0, false, simulations, threads, seed, batched, execution }, [&] (int i) {
+        children[i]->execution = execution ? &area_executions[i] : nullptr;
+        children[i]->dist_cache = dist_cache;
+        ProbabilityDistribution dist = children[i]->get_cached_dist(simulations, threads, area_seeds[i], batched);
+        children[i]->execution = execution;
+        return dist;
+    });
+}
+
+ProbabilityDistribution FullGame::get_exact_dist () {
+    return combine_areas({ 0, true, 0, 0, 0, false, nullptr }, [&] (int i) {
+        return children[i]->get_exact_dist();
+    });
 }
\ No newline at end of file
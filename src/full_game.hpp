@@ -1,18 +1,53 @@
 #ifndef FULL_GAME_H
 #define FULL_GAME_H
 
+#include <vector>
+#include <functional>
+#include <tuple>
 #include "simulator.hpp"
 
 // simulator for the entirety of the genocide run
 class FullGame : public Simulator {
 public:
-    FullGame (Times& times_value);
+    FullGame (const Times& times_value);
 
-    int simulate() override;
+    ~FullGame ();
+
+    int simulate (Random& rng, SampleContext& context) override;
+
+    int simulate (QuasiRandom& rng, SampleContext& context) override;
+
+    void simulate_batch (RandomLanes& lanes, int* results) override;
+
+    std::vector<std::string> get_parts () override;
+
+    int simulate_parts (Random& rng, SampleContext& context, int* part_times, std::int64_t* part_encounters) override;
+
+    Simulator* clone (const Times& times_value) override;
+
+    ProbabilityDistribution get_dist (std::int64_t simulations, int threads, std::uint64_t seed, bool batched) override;
+
+    ProbabilityDistribution get_exact_dist () override;
 
     static int const area_count = 4;
 
+    // in the order of `Areas`
     Simulator* children [area_count];
+
+private:
+    template <typename Rng>
+    int simulate_draws (Rng& rng, SampleContext& context);
+
+    // what an area distribution depends on: the hash of the times of the area, whether it's exact,
+    // and the simulations, threads, seed, batching and drawn times of `get_dist`
+    typedef std::tuple<std::uint64_t, bool, std::int64_t, int, std::uint64_t, bool, const ExecutionTimes*> AreaKey;
+
+    // distribution of each area from the last query, reused while the times of the area and the options don't change
+    std::vector<ProbabilityDistribution> area_dists;
+    AreaKey area_keys [area_count];
+    bool area_cached [area_count];
+
+    ProbabilityDistribution combine_areas (AreaKey options, const std::function<ProbabilityDistribution (int)>& get_area);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include <cmath>
+#include <algorithm>
+#include "importance.hpp"
+#include "undertale.hpp"
+#include "sobol.hpp"
+
+Proposal::Proposal () {
+    real[DrawSites::Ruins1] = Undertale::ruins1_chances();
+    real[DrawSites::Ruins3] = Undertale::ruins3_chances();
+    double whiff = Undertale::whiff_lv1_froggit_chance();
+    real[DrawSites::WhiffLv1Froggit] = { { 1, whiff }, { 0, 1 - whiff } };
+    real[DrawSites::Frogskip] = Undertale::frogskip_chances();
+    real[DrawSites::Snowdin] = Undertale::snowdin_chances();
+    real[DrawSites::GlowingWater] = Undertale::glowing_water_encounter_chances();
+    real[DrawSites::WaterfallGrind] = Undertale::waterfall_grind_encounter_chances();
+    real[DrawSites::Core] = Undertale::core_encounter_chances();
+
+    for (int site = 0; site < DrawSites::Count; site++) {
+        for (std::size_t result = 0; result < real[site].size(); result++) {
+            chances[site][result] = real[site][result].second;
+        }
+    }
+}
+
+// move the chances toward how often each result was drawn in the given simulations, each counting with its weight
+// (the cross-entropy method, where the simulations are the ones closest to the times of interest)
+// the chances only go part of the way and never get much smaller than the real ones, so that one unlucky round of
+// simulations can't leave a result that is hardly ever drawn, which would give the few times it is a huge weight
+void Proposal::fit (const std::vector<const double*>& counts, const std::vector<double>& weights) {
+    const double smoothing = 0.7;
+    const double smallest_fraction = 0.05;
+    for (int site = 0; site < DrawSites::Count; site++) {
+        int results = real[site].size();
+        double totals[max_results] = {};
+        double total = 0;
+        for (std::size_t i = 0; i < counts.size(); i++) {
+            for (int result = 0; result < results; result++) {
+                double count = counts[i][site * max_results + result] * weights[i];
+                totals[result] += count;
+                total += count;
+            }
+        }
+        // the site wasn't drawn in any of the simulations
+        if (total == 0) continue;
+
+        double sum = 0;
+        for (int result = 0; result < results; result++) {
+            double fitted = smoothing * totals[result] / total + (1 - smoothing) * chances[site][result];
+            chances[site][result] = std::max(fitted, smallest_fraction * real[site][result].second);
+            sum += chances[site][result];
+        }
+        for (int result = 0; result < results; result++) {
+            chances[site][result] /= sum;
+        }
+    }
+}
+
+DrawRecord::DrawRecord (const Proposal* proposal_value) : proposal(proposal_value), counts() {}
+
+// draw a result of a site from the chances of the proposal, keeping the record and the weight of the simulation
+// the weight is multiplied by the likelihood ratio (real chance / proposal chance), which makes the weighted
+// simulations average to the real distribution
+template <typename Rng>
+int Importance::draw (Rng& rng, SampleContext& context, int site) {
+    DrawRecord& record = *context.record;
+    const Chances& real = record.proposal->real[site];
+    const double* chances = record.proposal->chances[site];
+
+    double roll = rng.random_number();
+    std::size_t result = 0;
+    while (result + 1 < real.size() && roll >= chances[result]) {
+        roll -= chances[result];
+        result++;
+    }
+    context.weight *= real[result].second / chances[result];
+    record.counts[site][result]++;
+    return real[result].first;
+}
+
+template int Importance::draw (Random&, SampleContext&, int);
+template int Importance::draw (QuasiRandom&, SampleContext&, int);
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef IMPORTANCE_H
+#define IMPORTANCE_H
+
+#include <vector>
+#include "random.hpp"
+#include "sample_context.hpp"
+#include "probability_distribution.hpp"
+
+// random draws that importance sampling can change, each with its own chances
+namespace DrawSites {
+    enum {
+        Ruins1,
+        Ruins3,
+        WhiffLv1Froggit,
+        Frogskip,
+        Snowdin,
+        GlowingWater,
+        WaterfallGrind,
+        Core,
+        Count
+    };
+}
+
+// chances to draw each site from instead of the real ones, which importance sampling uses to make rare times common
+// the results of a site are in the order of its `Undertale::*_chances` table
+class Proposal {
+public:
+    // most results a site can have
+    static const int max_results = 8;
+
+    // real results and chances of each site
+    Chances real [DrawSites::Count];
+
+    double chances [DrawSites::Count][max_results];
+
+    // starts as the real chances
+    Proposal ();
+
+    void fit (const std::vector<const double*>& counts, const std::vector<double>& weights);
+};
+
+// what importance sampling keeps for one simulation: the chances it draws from, and how many times it drew each result
+struct DrawRecord {
+    const Proposal* proposal;
+    double counts [DrawSites::Count][Proposal::max_results];
+
+    DrawRecord (const Proposal* proposal_value);
+};
+
+class Importance {
+public:
+    template <typename Rng>
+    static int draw (Rng& rng, SampleContext& context, int site);
+};
+
+#endif
\ No newline at end of file
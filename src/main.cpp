@@ -1,5 +1,8 @@
 #include <iostream>
+#include <algorithm>
 #include <filesystem>
+#include <thread>
+#include <sstream>
 #include <shlobj.h>
 #include "random.hpp"
 #include "undertale.hpp"
@@ -12,6 +15,8 @@
 #include "waterfall.hpp"
 #include "endgame.hpp"
 #include "full_game.hpp"
+#include "server.hpp"
+#include "directory_watcher.hpp"
 #include "utils.hpp"
 
 using namespace std;
@@ -28,9 +33,51 @@ int main (int arc, char *argv[]) {
     int chance_min = -1;
     int chance_max = -1;
     bool use_best = false;
-    int simulations = 1'000'000;
+    std::int64_t simulations = 1'000'000;
     bool use_tas = false;
     int first_half_kills = 13;
+    int threads = std::max(1, (int) std::thread::hardware_concurrency());
+    std::uint64_t seed = time(0);
+    bool seed_given = false;
+    bool batched = false;
+    bool exact = false;
+    // targets for the margins of error, -1 if not used
+    double chance_margin = -1;
+    double average_margin = -1;
+    double time_limit = 60;
+    // thresholds (in frames) to get the chance of being under, and percentiles to get the time of
+    vector<int> thresholds;
+    vector<double> percentiles;
+    // seconds between the rows of the pace table, 0 if not printed
+    int pace_step = 0;
+    // variants of the ruins to compare, on the same random numbers
+    vector<int> sweep_kills;
+    bool sweep_tas = false;
+    // variance reduction
+    bool antithetic = false;
+    bool control_variates = false;
+    // randomized quasi-Monte Carlo replicates, 0 if not used
+    int quasi_replicates = 0;
+    // importance sampling for the chance
+    bool tail = false;
+    // draw the segment times of every simulation from the recordings
+    bool empirical = false;
+    // answer queries from the standard input instead of a single run
+    bool serve = false;
+    // print the results again whenever the recordings change
+    bool watch = false;
+    // files to write the distribution to, as text and binary, and the file to write every simulation to instead of a normal run
+    string export_text;
+    string export_binary;
+    string export_samples;
+    // keep the simulated distributions in the recordings directory
+    bool use_cache = true;
+    // file keeping what the simulations read from the times, so they can be timed again without simulating
+    string usage_model;
+    // frames added to the value of some segments, to see what saving (or losing) time in them would do
+    vector<pair<string, int>> what_if;
+    // rank the segments by how much taking time off them raises the chance under -x
+    bool sensitivity = false;
     string run;
 
     int cur_arg = 1;
@@ -45,7 +92,7 @@ int main (int arc, char *argv[]) {
                 break;
             case 's':
                 cur_arg++;
-                simulations = stoi(argv[cur_arg]);
+                simulations = stoll(argv[cur_arg]);
                 break;
             case 'a':
                 get_avg = true;
@@ -75,51 +122,452 @@ int main (int arc, char *argv[]) {
                 cur_arg++;
                 first_half_kills = stoi(argv[cur_arg]);
                 break;
+            case 't':
+                cur_arg++;
+                threads = stoi(argv[cur_arg]);
+                break;
+            // long options
+            case '-': {
+                string option = argv[cur_arg];
+                if (option == "--seed") {
+                    cur_arg++;
+                    seed = stoull(argv[cur_arg]);
+                    seed_given = true;
+                } else if (option == "--batch") {
+                    batched = true;
+                } else if (option == "--exact") {
+                    exact = true;
+                } else if (option == "--chance-margin") {
+                    cur_arg++;
+                    chance_margin = stod(argv[cur_arg]);
+                } else if (option == "--average-margin") {
+                    cur_arg++;
+                    average_margin = stod(argv[cur_arg]);
+                } else if (option == "--time-limit") {
+                    cur_arg++;
+                    time_limit = stod(argv[cur_arg]);
+                } else if (option == "--under") {
+                    cur_arg++;
+                    for (const string& threshold : Utils::split(argv[cur_arg], ',')) {
+                        thresholds.push_back(Utils::parse_frames(threshold));
+                    }
+                } else if (option == "--percentiles") {
+                    cur_arg++;
+                    for (const string& percentile : Utils::split(argv[cur_arg], ',')) {
+                        percentiles.push_back(stod(percentile));
+                    }
+                } else if (option == "--pace") {
+                    cur_arg++;
+                    pace_step = stoi(argv[cur_arg]);
+                } else if (option == "--sweep-kills") {
+                    cur_arg++;
+                    for (const string& kills : Utils::split(argv[cur_arg], ',')) {
+                        sweep_kills.push_back(stoi(kills));
+                    }
+                } else if (option == "--sweep-tas") {
+                    sweep_tas = true;
+                } else if (option == "--antithetic") {
+                    antithetic = true;
+                } else if (option == "--control-variates") {
+                    control_variates = true;
+                } else if (option == "--sobol") {
+                    cur_arg++;
+                    quasi_replicates = stoi(argv[cur_arg]);
+                } else if (option == "--tail") {
+                    tail = true;
+                } else if (option == "--empirical") {
+                    empirical = true;
+                } else if (option == "--serve") {
+                    serve = true;
+                } else if (option == "--watch") {
+                    watch = true;
+                } else if (option == "--no-cache") {
+                    use_cache = false;
+                } else if (option == "--export-text") {
+                    cur_arg++;
+                    export_text = argv[cur_arg];
+                } else if (option == "--export-binary") {
+                    cur_arg++;
+                    export_binary = argv[cur_arg];
+                } else if (option == "--export-samples") {
+                    cur_arg++;
+                    export_samples = argv[cur_arg];
+                } else if (option == "--usage-model") {
+                    cur_arg++;
+                    usage_model = argv[cur_arg];
+                } else if (option == "--sensitivity") {
+                    sensitivity = true;
+                } else if (option == "--what-if") {
+                    cur_arg++;
+                    for (const string& change : Utils::split(argv[cur_arg], ',')) {
+                        size_t equals = change.rfind('=');
+                        if (equals == string::npos) continue;
+                        what_if.push_back({ change.substr(0, equals), stoi(change.substr(equals + 1)) });
+                    }
+                }
+                break;
+            }
         }
         cur_arg++;
     }
 
-    // seed program
-    srand(time(0));
+    // every simulation loop splits the simulations between the workers
+    if (threads < 1) {
+        cout << "Error: the number of threads (-t) must be at least 1" << endl;
+        return 1;
+    }
 
-    RecordingReader reader(dir);
+    RecordingReader reader(dir, threads);
+    if (serve) {
+        Server server(reader, threads, simulations, seed);
+        server.run(cin, cout);
+        return 0;
+    }
+
+    // the recorded values, with the changes asked for
+    auto read_values = [&] () {
+        unordered_map<string, int> values = reader.get_values(use_best);
+        for (const auto& [name, frames] : what_if) {
+            auto value = values.find(name);
+            if (value == values.end()) throw runtime_error("segment \"" + name + "\" isn't in the recordings");
+            value->second += frames;
+        }
+        return values;
+    };
+    auto read_times = [&] () {
+        return Times(read_values());
+    };
+
+    if (empirical && !what_if.empty()) {
+        cout << "Error: --what-if can't be used with --empirical" << endl;
+        return 1;
+    }
     Times times;
-    if (use_best) times = reader.get_best();
-    else times = reader.get_average();
+    // the drawn times average out to the average times, which the simulators are built with
+    ExecutionTimes* execution = nullptr;
+    try {
+        if (empirical) {
+            execution = new ExecutionTimes(reader.read_all());
+            times = execution->average;
+        }
+        else times = read_times();
+    } catch (const runtime_error& error) {
+        cout << "Error: " << error.what() << endl;
+        return 1;
+    }
+
+    // without a seed, the stored distributions are used whatever seed they had
+    DistCache* dist_cache = use_cache ? new DistCache(dir, !seed_given) : nullptr;
 
     Simulator* simulator = nullptr;
-    if (run == "ruins") {
-        simulator = new Ruins(times, !use_tas, first_half_kills);
-    } else if (run == "snowdin") {
-        simulator = new Snowdin(times);
-    } else if (run == "waterfall") {
-        simulator = new Waterfall(times);
-    } else if (run == "endgame") {
-        simulator = new Endgame(times);
-    } else if (run == "full") {
-        simulator = new FullGame(times);
+    // the simulators check that every segment they need was recorded
+    try {
+        if (run == "ruins") {
+            simulator = new Ruins(times, !use_tas, first_half_kills);
+        } else if (run == "snowdin") {
+            simulator = new Snowdin(times);
+        } else if (run == "waterfall") {
+            simulator = new Waterfall(times);
+        } else if (run == "endgame") {
+            simulator = new Endgame(times);
+        } else if (run == "full") {
+            simulator = new FullGame(times);
+        }
+        else throw new exception();
+
+        // a single area only draws the segments it reads
+        for (int area = 0; area < Areas::Count; area++) {
+            if (execution && run == area_names[area]) *execution = execution->for_area(area);
+        }
+        simulator->execution = execution;
+        simulator->dist_cache = dist_cache;
+    } catch (const runtime_error& error) {
+        cout << "Error: " << error.what() << endl;
+        return 1;
     }
-    else throw new exception();
 
-    ProbabilityDistribution dist = simulator->get_dist(simulations);
-    delete simulator;
-    
-    if (calculate_chance) {
-        double chance;
-        if (chance_min == -1 && chance_max == -1) chance = 1;
-        else if (chance_min == -1) chance = dist.get_chance_up_to(chance_max);
-        else if (chance_max == -1) chance = dist.get_chance_from(chance_min);
-        else chance = dist.get_chance(chance_min, chance_max);
-        cout << "Chance: " << chance * 100 << "%" << endl;;
+    auto get_chance = [&] (ProbabilityDistribution& dist) {
+        if (chance_min == -1 && chance_max == -1) return 1.0;
+        else if (chance_min == -1) return dist.get_chance_up_to(chance_max);
+        else if (chance_max == -1) return dist.get_chance_from(chance_min);
+        else return dist.get_chance(chance_min, chance_max);
+    };
+
+    auto in_range = [&] (int time) {
+        return (chance_min == -1 || time >= chance_min) && (chance_max == -1 || time < chance_max);
+    };
+
+    if (!export_samples.empty()) {
+        try {
+            simulator->export_samples(export_samples, simulations, threads, seed);
+        } catch (const runtime_error& error) {
+            cout << "Error: " << error.what() << endl;
+            return 1;
+        }
+        cout << "Simulations written to " << export_samples << endl;
+        delete dist_cache;
+        delete simulator;
+        delete execution;
+        return 0;
+    }
+
+    // compare variants of the ruins, the first one being what the others are compared to
+    if (!sweep_kills.empty() || sweep_tas) {
+        if (run != "ruins") {
+            cout << "Error: sweeps are only available for the ruins" << endl;
+            return 1;
+        }
+        if (sweep_kills.empty()) sweep_kills.push_back(first_half_kills);
+        vector<bool> starts = { !use_tas };
+        if (sweep_tas) starts = { true, false };
+
+        vector<Simulator*> variants;
+        vector<string> names;
+        try {
+            for (bool glitchless : starts) {
+                for (int kills : sweep_kills) {
+                    variants.push_back(new Ruins(times, glitchless, kills));
+                    names.push_back(string(glitchless ? "Glitchless" : "TAS") + ", " + to_string(kills) + " first half kills");
+                }
+            }
+        } catch (const runtime_error& error) {
+            cout << "Error: " << error.what() << endl;
+            return 1;
+        }
+
+        PairedDists results = Simulator::get_paired_dists(variants, in_range, simulations, threads, seed);
+        for (size_t variant = 0; variant < variants.size(); variant++) {
+            cout << names[variant] << endl;
+            ProbabilityDistribution& time_difference = results.time_differences[variant];
+            ProbabilityDistribution& chance_difference = results.chance_differences[variant];
+            // differences to the first variant with 99% confidence intervals
+            if (calculate_chance) {
+                cout << "  Chance: " << get_chance(results.dists[variant]) * 100 << "%";
+                if (variant > 0) {
+                    cout << " (" << showpos << chance_difference.get_average() * 100 << noshowpos << "% +- "
+                        << simulator->get_average_error_margin(chance_difference) * 100 << "%)";
+                }
+                cout << endl;
+            }
+            if (get_avg) {
+                cout << "  Average: " << Utils::frame_to_time(results.dists[variant].get_average());
+                if (variant > 0) {
+                    cout << " (" << showpos << time_difference.get_average() << noshowpos << " +- "
+                        << simulator->get_average_error_margin(time_difference) << " frames)";
+                }
+                cout << endl;
+            }
+            if (get_stdev) {
+                cout << "  Standard Deviation: " << Utils::frame_to_time(results.dists[variant].get_stdev()) << endl;
+            }
+            delete variants[variant];
+        }
+        delete dist_cache;
+        delete simulator;
+        delete execution;
+        return 0;
     }
-    if (get_avg) {
-        double average = dist.get_average();
-        cout << "Average: " << Utils::frame_to_time(average) << endl;
+
+    // if there are target margins, simulate until they are reached instead of a fixed number of times
+    bool adaptive = !exact && (chance_margin != -1 || average_margin != -1);
+    auto precise_enough = [&] (ProbabilityDistribution& dist) {
+        if (chance_margin != -1 && simulator->get_error_margin(dist.get_samples(), get_chance(dist)) * 100 > chance_margin) {
+            return false;
+        }
+        if (average_margin != -1 && simulator->get_average_error_margin(dist) > average_margin) return false;
+        return true;
+    };
+
+    // chances in the tails are estimated on their own, since the distribution of the importance sampled times is skewed
+    if (tail) {
+        // how far a time is from the range, for finding the chances that make it common
+        auto distance = [&] (int time) {
+            if (chance_min != -1 && time < chance_min) return (double) (chance_min - time);
+            if (chance_max != -1 && time >= chance_max) return (double) (time - chance_max + 1);
+            return 0.0;
+        };
+        Proposal proposal = simulator->find_proposal(distance, threads, seed);
+        Estimate chance = simulator->get_tail_estimate(in_range, simulations, threads, seed + 1, proposal);
+        cout << "Simulations: " << simulations << endl;
+        cout << "Chance: " << chance.value * 100 << "% +- " << chance.margin * 100 << "%"
+            << " (effective simulations: " << (std::int64_t) chance.effective_samples << ")" << endl;
+        delete dist_cache;
+        delete simulator;
+        delete execution;
+        return 0;
     }
-    if (get_stdev) {
-        double stdev = dist.get_stdev();
-        cout << "Standard Deviation: " << Utils::frame_to_time(stdev) << endl;
+
+    if (watch && empirical) {
+        cout << "Error: --watch can't be used with --empirical" << endl;
+        return 1;
+    }
+    DirectoryWatcher* watcher = watch ? new DirectoryWatcher(dir) : nullptr;
+
+    // the simulations are made once and kept in the file, then timed with the times of every run
+    // the model doesn't depend on the times, and without a seed any seed it was made with is used
+    // the sensitivities are read from a model, kept in memory if there's no file for it
+    if (sensitivity && chance_max == -1) {
+        cout << "Error: --sensitivity needs a time to be under (-x)" << endl;
+        return 1;
+    }
+    UsageModel* model = nullptr;
+    if (!usage_model.empty() || sensitivity) {
+        ostringstream options;
+        options << run << (use_tas ? " tas " : " glitchless ") << first_half_kills << " " << simulations << " ";
+        string description = options.str() + to_string(seed);
+        model = new UsageModel();
+        bool loaded = !usage_model.empty() && model->load(usage_model);
+        if (!loaded || (seed_given ? model->description != description : model->description.rfind(options.str(), 0) != 0)) {
+            try {
+                *model = simulator->get_usage_model(simulations, threads, seed);
+            } catch (const runtime_error& error) {
+                cout << "Error: " << error.what() << endl;
+                return 1;
+            }
+            model->description = description;
+            if (!usage_model.empty()) {
+                model->save(usage_model);
+                cout << "Usage model written to " << usage_model << " (" << model->patterns.size() << " patterns)" << endl;
+            }
+        }
+    }
+
+    // with a watch, the results are printed again every time the recordings change
+    while (true) {
+        // with variance reduction, the chance and the average come with their own estimates
+        bool reduced = !exact && !adaptive && (antithetic || control_variates || quasi_replicates != 0);
+        Estimate chance_estimate = {};
+        Estimate average_estimate = {};
+
+        ProbabilityDistribution dist(1);
+        try {
+            if (exact) dist = simulator->get_exact_dist();
+            else if (adaptive) dist = simulator->get_dist_until(precise_enough, time_limit, threads, seed, batched);
+            else if (reduced) {
+                ReducedEstimates estimates = quasi_replicates != 0
+                    ? simulator->get_quasi_estimates(in_range, simulations, quasi_replicates, threads, seed)
+                    : simulator->get_reduced_estimates(in_range, simulations, threads, seed, antithetic, control_variates);
+                dist = estimates.dist;
+                chance_estimate = estimates.chance;
+                average_estimate = estimates.average;
+            }
+            else if (model) dist = model->evaluate(times, threads);
+            else dist = simulator->get_cached_dist(simulations, threads, seed, batched);
+        } catch (const runtime_error& error) {
+            cout << "Error: " << error.what() << endl;
+            return 1;
+        }
+    
+        if (adaptive || reduced) {
+            cout << "Simulations: " << dist.get_samples() << endl;
+        }
+        // 99% confidence intervals
+        if (calculate_chance) {
+            if (reduced) {
+                cout << "Chance: " << chance_estimate.value * 100 << "% +- " << chance_estimate.margin * 100 << "%"
+                    << " (effective simulations: " << (std::int64_t) chance_estimate.effective_samples << ")" << endl;
+            } else {
+                double chance = get_chance(dist);
+                cout << "Chance: " << chance * 100 << "%";
+                if (adaptive) cout << " +- " << simulator->get_error_margin(dist.get_samples(), chance) * 100 << "%";
+                cout << endl;
+            }
+        }
+        if (get_avg) {
+            if (reduced) {
+                cout << "Average: " << Utils::frame_to_time(average_estimate.value) << " +- " << average_estimate.margin << " frames"
+                    << " (effective simulations: " << (std::int64_t) average_estimate.effective_samples << ")" << endl;
+            } else {
+                double average = dist.get_average();
+                cout << "Average: " << Utils::frame_to_time(average);
+                if (adaptive) cout << " +- " << simulator->get_average_error_margin(dist) << " frames";
+                cout << endl;
+            }
+        }
+        if (get_stdev) {
+            double stdev = dist.get_stdev();
+            cout << "Standard Deviation: " << Utils::frame_to_time(stdev) << endl;
+        }
+        // every query below reads the same distribution, so they take no extra simulations
+        for (int threshold : thresholds) {
+            cout << "Chance under " << Utils::frame_to_time(threshold) << ": " << dist.get_chance_up_to(threshold) * 100 << "%" << endl;
+        }
+        for (double percentile : percentiles) {
+            cout << "Percentile " << percentile << ": " << Utils::frame_to_time(dist.get_percentile(percentile / 100)) << endl;
+        }
+        if (pace_step > 0) {
+            // a row for every step between the 0.1% and 99.9% percentiles, the rest are too far in the tails to be useful
+            int step = pace_step * 30;
+            int last = dist.get_percentile(0.999);
+            cout << "Pace table:" << endl;
+            for (int threshold = (dist.get_percentile(0.001) / step + 1) * step; threshold - step <= last; threshold += step) {
+                cout << "  sub " << Utils::frame_to_time(threshold) << ": " << dist.get_chance_up_to(threshold) * 100 << "%" << endl;
+            }
+        }
+        if (sensitivity) {
+            // a recorded segment can be part of many times (like the static time of an area), so every one
+            // is taken a frame off and the times are built again, to see everything it changes
+            unordered_map<string, int> values = read_values();
+            vector<string> names;
+            vector<TimesChange> changes;
+            for (const auto& [name, value] : values) {
+                unordered_map<string, int> saved = values;
+                saved[name]--;
+                TimesChange change = UsageModel::get_change(times, Times(saved));
+                if (change.empty()) continue;
+                names.push_back(name);
+                changes.push_back(change);
+            }
+            vector<Sensitivity> sensitivities = model->get_sensitivities(times, chance_max, changes, threads);
+            vector<size_t> order(names.size());
+            for (size_t i = 0; i < order.size(); i++) order[i] = i;
+            sort(order.begin(), order.end(), [&] (size_t a, size_t b) {
+                if (sensitivities[a].chance != sensitivities[b].chance) return sensitivities[a].chance > sensitivities[b].chance;
+                return names[a] < names[b];
+            });
+            // per second (30 frames) taken off each segment, with 99% confidence intervals
+            cout << "Practice priority (chance under " << Utils::frame_to_time(chance_max) << " and average time gained per second saved):" << endl;
+            for (size_t i : order) {
+                cout << "  " << names[i] << ": " << showpos << sensitivities[i].chance * 30 * 100 << noshowpos << "% +- "
+                    << sensitivities[i].margin * 30 * 100 << "%, " << sensitivities[i].time << " seconds" << endl;
+            }
+        }
+        if (!export_text.empty()) dist.export_dist(export_text);
+        if (!export_binary.empty()) dist.export_binary(export_binary);
+
+        if (!watcher) break;
+        // the simulators keep reading `times`, which is updated in place with the new recordings,
+        // and only the areas whose times changed are simulated again (the full game keeps the rest)
+        vector<bool> area_changed(Areas::Count);
+        bool any_changed = false;
+        try {
+            while (!any_changed) {
+                if (!reader.update(watcher->wait())) continue;
+                Times updated = read_times();
+                for (int area = 0; area < Areas::Count; area++) {
+                    if (updated.area_hash(area) == times.area_hash(area)) continue;
+                    area_changed[area] = true;
+                    any_changed = any_changed || run == "full" || run == area_names[area];
+                }
+                times = updated;
+            }
+            // check that the new times still have every segment
+            delete simulator->clone(times);
+        } catch (const runtime_error& error) {
+            cout << "Error: " << error.what() << endl;
+            return 1;
+        }
+        cout << endl << "Recordings changed in:";
+        for (int area = 0; area < Areas::Count; area++) {
+            if (area_changed[area]) cout << " " << area_names[area];
+        }
+        cout << endl;
     }
+    delete watcher;
+    delete model;
+    delete dist_cache;
+    delete simulator;
+    delete execution;
 
     return 0;
 }
@@ -0,0 +1,49 @@
+#include "moments.hpp"
+
+Moments::Moments (int size_value) : size(size_value), count(0), means(size_value, 0), comoments(size_value * size_value, 0) {}
+
+// add one measurement of every value
+void Moments::add (const double* values) {
+    count++;
+    double deltas[max_size];
+    for (int i = 0; i < size; i++) {
+        deltas[i] = values[i] - means[i];
+        means[i] += deltas[i] / count;
+    }
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            comoments[i * size + j] += deltas[i] * (values[j] - means[j]);
+        }
+    }
+}
+
+// merge the measurements of another object with the same values
+void Moments::add (const Moments& other) {
+    if (other.count == 0) return;
+    std::uint64_t total = count + other.count;
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            double delta_i = other.means[i] - means[i];
+            double delta_j = other.means[j] - means[j];
+            comoments[i * size + j] += other.comoments[i * size + j] + delta_i * delta_j * count * other.count / total;
+        }
+    }
+    for (int i = 0; i < size; i++) {
+        means[i] += (other.means[i] - means[i]) * other.count / total;
+    }
+    count = total;
+}
+
+std::uint64_t Moments::get_count () {
+    return count;
+}
+
+double Moments::get_mean (int i) {
+    return means[i];
+}
+
+// sample covariance between two of the values (the variance if it's the same value)
+double Moments::get_covariance (int i, int j) {
+    if (count < 2) return 0;
+    return comoments[i * size + j] / (count - 1);
+}
\ No newline at end of file
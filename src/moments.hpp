@@ -0,0 +1,33 @@
+#ifndef MOMENTS_H
+#define MOMENTS_H
+
+#include <vector>
+#include <cstdint>
+
+// running averages and covariances of several values measured together, such as the time of a simulation and the
+// random parts it was made of, updated as the values are added so nothing has to be stored
+class Moments {
+    int size;
+    std::uint64_t count;
+    std::vector<double> means;
+    // sums of the products of the deviations from the averages, `size` by `size`
+    std::vector<double> comoments;
+
+public:
+    // most values that can be measured together
+    static const int max_size = 8;
+
+    Moments (int size_value);
+
+    void add (const double* values);
+
+    void add (const Moments& other);
+
+    std::uint64_t get_count ();
+
+    double get_mean (int i);
+
+    double get_covariance (int i, int j);
+};
+
+#endif
\ No newline at end of file
@@ -1,56 +1,245 @@
 #include <cmath>
 #include <fstream>
+#include <algorithm>
+#include <complex>
+#include <cstring>
+#include <iomanip>
+#include <limits>
 #include "probability_distribution.hpp"
 
-void ProbabilityDistribution::build_dist (int* values, int size) {
-    // add +1 to include the maximum value as well, due to 0-indexsng
-    // length is calculated from the range and bin size
-    length = (max + 1 - min) / interval;
-    
-    total = 0;
+ProbabilityDistribution::ProbabilityDistribution (int interval_value)
+    : start(0), min(0), max(0), interval(interval_value), total(0), samples(0), mean(0), squared_deviations(0) {}
 
-    // actual distribution is just an array where each element of the array represents a "x" position
-    // and the value is the number of time it appears in that "x" position
-    distribution = new int[length] {0};
+ProbabilityDistribution::ProbabilityDistribution (int interval_value, int* values, int size)
+    : ProbabilityDistribution(interval_value) {
     for (int i = 0; i < size; i++) {
-        int pos = get_distribution_pos(values[i]);
-        distribution[pos]++;
-        total++;
+        add_value(values[i]);
     }
 }
 
-ProbabilityDistribution::ProbabilityDistribution (int interval_value, int* values, int size)
-: interval(interval_value), max(0), min(std::numeric_limits<int>::max()) {
-    // determine max and minimum values in the distribution
+// the range is only used to reserve the bins, values outside of it still grow the distribution
+ProbabilityDistribution::ProbabilityDistribution (int min_value, int max_value, int interval_value, int* values, int size)
+    : ProbabilityDistribution(interval_value) {
+    start = min_value;
+    distribution.assign((max_value - min_value) / interval + 1, 0);
     for (int i = 0; i < size; i++) {
-        int current = values[i];
-        if (current > max) max = current;
-        else if (current < min) min = current;
+        add_value(values[i]);
     }
-    build_dist(values, size);
 }
 
-ProbabilityDistribution::ProbabilityDistribution (int min_value, int max_value, int interval_value, int* values, int size)
-    : min(min_value), max(max_value), interval(interval_value) {
-        build_dist(values, size);
+// distribution with an interval of 1 where each value has the given chance
+ProbabilityDistribution::ProbabilityDistribution (const Chances& chances) : ProbabilityDistribution(1) {
+    for (const auto& chance : chances) {
+        add_weight(chance.first, chance.second);
+    }
+}
+
+// put `weight` in the bin of `value`, adding bins to either side if it doesn't exist yet
+void ProbabilityDistribution::add_bin (int value, double weight) {
+    if (distribution.empty()) {
+        start = value;
+        distribution.assign(1, 0);
+    }
+
+    if (value < start) {
+        // grow by at least the current size so that adding values in decreasing order stays cheap
+        int missing = (start - value + interval - 1) / interval;
+        int extra = std::max(missing, (int) distribution.size());
+        distribution.insert(distribution.begin(), extra, 0);
+        start -= extra * interval;
+    }
+
+    cumulative.clear();
+    std::size_t pos = (value - start) / interval;
+    if (pos >= distribution.size()) {
+        distribution.resize(std::max(pos + 1, 2 * distribution.size()), 0);
+    }
+    distribution[pos] += weight;
+
+    if (total == 0 || value < min) min = value;
+    if (total == 0 || value > max) max = value;
+    total += weight;
+}
+
+// add a single simulated value to the distribution
+void ProbabilityDistribution::add_value (int value) {
+    add_weight(value, 1);
+    samples++;
+}
+
+// add a value with a weight to the distribution
+void ProbabilityDistribution::add_weight (int value, double weight) {
+    if (weight <= 0) return;
+    add_bin(value, weight);
+    double delta = value - mean;
+    mean += delta * weight / total;
+    squared_deviations += weight * delta * (value - mean);
+}
+
+// merge the values of another distribution with the same interval into this one
+void ProbabilityDistribution::add (const ProbabilityDistribution& other) {
+    if (other.total == 0) return;
+
+    double previous_total = total;
+    for (std::size_t i = 0; i < other.distribution.size(); i++) {
+        if (other.distribution[i] != 0) add_bin(other.start + i * other.interval, other.distribution[i]);
+    }
+    // the extremes can have no weight left (like the tails dropped by a convolution), but the bins still have to reach them
+    add_bin(other.min, 0);
+    add_bin(other.max, 0);
+    samples += other.samples;
+    // keep the extremes exact, since the bins only know the lower value of each bin
+    min = previous_total == 0 ? other.min : std::min(min, other.min);
+    max = previous_total == 0 ? other.max : std::max(max, other.max);
+
+    // combining the running values of both sides
+    double delta = other.mean - mean;
+    double weight = other.total / total;
+    mean += delta * weight;
+    squared_deviations += other.squared_deviations + delta * delta * previous_total * weight;
+}
+
+// add a fixed amount to every value
+void ProbabilityDistribution::shift (int offset) {
+    start += offset;
+    min += offset;
+    max += offset;
+    mean += offset;
+}
+
+// multiply the weight of every value, used to weight the branches of exact distributions by their chance
+void ProbabilityDistribution::scale (double factor) {
+    for (double& weight : distribution) {
+        weight *= factor;
+    }
+    cumulative.clear();
+    total *= factor;
+    squared_deviations *= factor;
+}
+
+// in-place iterative radix-2 fast fourier transform, the size must be a power of 2
+static void fft (std::vector<std::complex<double>>& values, bool inverse) {
+    std::size_t n = values.size();
+    for (std::size_t i = 1, j = 0; i < n; i++) {
+        std::size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(values[i], values[j]);
+    }
+    for (std::size_t length = 2; length <= n; length <<= 1) {
+        double angle = 2 * std::acos(-1.0) / length * (inverse ? -1 : 1);
+        std::complex<double> step(std::cos(angle), std::sin(angle));
+        for (std::size_t i = 0; i < n; i += length) {
+            std::complex<double> root(1);
+            for (std::size_t j = 0; j < length / 2; j++) {
+                std::complex<double> even = values[i + j];
+                std::complex<double> odd = values[i + j + length / 2] * root;
+                values[i + j] = even + odd;
+                values[i + j + length / 2] = even - odd;
+                root *= step;
+            }
+        }
     }
+    if (inverse) {
+        for (auto& value : values) value /= (double) n;
+    }
+}
+
+// turn this into the distribution of the sum of a value from this and a value from `other`, both with an interval of 1
+// the direct sum is used when one side is small (like the chances of a step count), and FFT for large ones (like whole areas)
+void ProbabilityDistribution::convolve (const ProbabilityDistribution& other) {
+    if (total == 0) return;
+    if (other.total == 0) {
+        *this = ProbabilityDistribution(interval);
+        return;
+    }
+
+    // only the bins between the extremes have weight
+    const double* values = distribution.data() + (min - start);
+    const double* other_values = other.distribution.data() + (other.min - other.start);
+    std::size_t length = max - min + 1;
+    std::size_t other_length = other.max - other.min + 1;
+    std::vector<double> result(length + other_length - 1, 0);
+
+    std::size_t size = 1;
+    int levels = 0;
+    for (; size < result.size(); size <<= 1) levels++;
+    // the direct sum skips the empty bins of `other`, which are most of them in the branches of exact distributions
+    std::size_t other_used = std::count_if(other_values, other_values + other_length, [] (double weight) { return weight != 0; });
+    // rough cost of each, measured with the transforms taking about 40 times a multiply-add for each value and level
+    if ((double) other_used * length <= 40.0 * size * levels) {
+        for (std::size_t i = 0; i < other_length; i++) {
+            double other_weight = other_values[i];
+            if (other_weight == 0) continue;
+            for (std::size_t j = 0; j < length; j++) {
+                result[i + j] += other_weight * values[j];
+            }
+        }
+    } else {
+        // both sides are normalized and packed as the real and imaginary parts, so that the square of the transform
+        // has twice their convolution in its imaginary part, needing only one transform each way
+        std::vector<std::complex<double>> packed(size);
+        for (std::size_t i = 0; i < length; i++) packed[i].real(values[i] / total);
+        for (std::size_t i = 0; i < other_length; i++) packed[i].imag(other_values[i] / other.total);
+        fft(packed, false);
+        for (auto& value : packed) value *= value;
+        fft(packed, true);
+
+        for (std::size_t i = 0; i < result.size(); i++) {
+            // rounding errors leave tiny values (that can be negative) where the chance should be 0
+            double weight = packed[i].imag() / 2;
+            result[i] = weight > 1e-15 ? weight * total * other.total : 0;
+        }
+    }
+
+    distribution = result;
+    cumulative.clear();
+    // the variances of independent values add up
+    squared_deviations = total * other.total * (squared_deviations / total + other.squared_deviations / other.total);
+    total *= other.total;
+    // the sum is only as well known as the least simulated side, exact distributions don't limit it
+    if (samples == 0 || (other.samples != 0 && other.samples < samples)) samples = other.samples;
+    min += other.min;
+    max += other.max;
+    start = min;
+    mean += other.mean;
+}
 
 // get the "x" position for a value in the distribution
 int ProbabilityDistribution::get_distribution_pos (int value) {
-    if (value < min) return 0;
+    int length = (max - start) / interval + 1;
+    if (value < start) return 0;
     if (value > max) return length;
-    return (value - min) / interval;
+    return (value - start) / interval;
+}
+
+// get the sum of the weights of all values
+double ProbabilityDistribution::get_total () {
+    return total;
+}
+
+// get how many simulated values were added
+std::uint64_t ProbabilityDistribution::get_samples () {
+    return samples;
+}
+
+// sum the weights of the bins once, so that queries don't walk them
+void ProbabilityDistribution::build_cumulative () {
+    if (!cumulative.empty()) return;
+    cumulative.assign(distribution.size() + 1, 0);
+    for (std::size_t i = 0; i < distribution.size(); i++) {
+        cumulative[i + 1] = cumulative[i] + distribution[i];
+    }
 }
 
 // get the chance a value is in the interval min (including) to max (excluding)
 double ProbabilityDistribution::get_chance (int min, int max) {
-    int favorable = 0;
+    if (total == 0) return 0;
+    build_cumulative();
     int lower_pos = get_distribution_pos(min);
     int higher_pos = get_distribution_pos(max);
-    for (int i = lower_pos; i < higher_pos; i++) {
-        favorable += distribution[i];
-    }
-    return (double) favorable / (double) total;
+    if (higher_pos <= lower_pos) return 0;
+    return (cumulative[higher_pos] - cumulative[lower_pos]) / total;
 }
 
 // get the chance a value is in the interval starting at the minimum up to a value
@@ -60,38 +249,101 @@ double ProbabilityDistribution::get_chance_up_to (int max) {
 
 // get the chance a value is in the interval starting at a given minimum value up to the max
 double ProbabilityDistribution::get_chance_from (int min) {
-    return get_chance(min, max);
+    return get_chance(min, max + 1);
+}
+
+// get the smallest value that has at least `fraction` of the weight up to (and including) it, with a binary search
+// the values are only known up to their bin, so the lowest value of the bin is given
+int ProbabilityDistribution::get_percentile (double fraction) {
+    if (total == 0) return 0;
+    build_cumulative();
+    auto bin_end = std::lower_bound(cumulative.begin() + 1, cumulative.end(), fraction * total);
+    if (bin_end == cumulative.end()) return max;
+    int value = start + (bin_end - cumulative.begin() - 1) * interval;
+    return std::clamp(value, min, max);
 }
 
-// simulating a rieman integral for the functions below like \int x \rho(x) dx / \int \rho(x) dx
+// the running values are exact, unlike integrating over the bins
 
 // get average value
 double ProbabilityDistribution::get_average () {
-    double numerator = 0;
-    for (int i = 0; i < length; i++) {
-        numerator += (min + interval * i) * distribution[i];
-    }
-    return numerator / (double) total;
+    return mean;
 }
 
 // get average of square of values
 double ProbabilityDistribution::get_sqr_avg () {
-    double numerator = 0;
-    for (int i = 0; i < length; i++) {
-        numerator += std::pow(min + interval * i, 2) * distribution[i];
-    }
-    return numerator / (double) total;
+    return squared_deviations / total + mean * mean;
 }
 
 // get the standard deviation of the values
 double ProbabilityDistribution::get_stdev () {
-    return std::sqrt(get_sqr_avg() - std::pow(get_average(), 2));
+    return std::sqrt(squared_deviations / total);
 }
 
 void ProbabilityDistribution::export_dist (std::string name) {
     std::ofstream file(name);
+    // the bins past the one of `max` are only reserved
+    int length = total == 0 ? 0 : (max - start) / interval + 1;
+    // bins of simulated values are counts, and are written as such, the others keep every digit of their weights
+    bool counts = samples == total;
+    file << std::setprecision(std::numeric_limits<double>::max_digits10);
     for (int i = 0; i < length; i++) {
-        file << min + i << "," << distribution[i] << std::endl;
+        file << start + i * interval << ",";
+        if (counts) file << (std::uint64_t) distribution[i];
+        else file << distribution[i];
+        file << '\n';
     }
     file.close();
+}
+
+// the distribution as written by `write`, after 8 bytes to recognize the file
+void ProbabilityDistribution::export_binary (std::string name) {
+    std::string buffer = "DISTRIB1";
+    write(buffer);
+    std::ofstream file(name, std::ios::binary);
+    file.write(buffer.data(), buffer.size());
+    file.close();
+}
+
+// append the distribution to `buffer` in binary, to be read back with `read`
+void ProbabilityDistribution::write (std::string& buffer) const {
+    auto write_value = [&buffer] (const auto& value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    write_value((std::int32_t) start);
+    write_value((std::int32_t) min);
+    write_value((std::int32_t) max);
+    write_value((std::int32_t) interval);
+    write_value(total);
+    write_value(samples);
+    write_value(mean);
+    write_value(squared_deviations);
+    write_value((std::uint32_t) distribution.size());
+    buffer.append(reinterpret_cast<const char*>(distribution.data()), distribution.size() * sizeof(double));
+}
+
+// read a distribution written by `write` from `pos`, moving it past it
+// returns false without reading everything if the data is cut
+bool ProbabilityDistribution::read (const char*& pos, const char* end) {
+    auto read_value = [&] (auto& value) {
+        if ((std::size_t) (end - pos) < sizeof(value)) return false;
+        std::memcpy(&value, pos, sizeof(value));
+        pos += sizeof(value);
+        return true;
+    };
+    std::int32_t header[4];
+    std::uint32_t size;
+    if (!read_value(header) || !read_value(total) || !read_value(samples) || !read_value(mean) ||
+        !read_value(squared_deviations) || !read_value(size) || (std::size_t) (end - pos) / sizeof(double) < size || header[3] <= 0) {
+        return false;
+    }
+    start = header[0];
+    min = header[1];
+    max = header[2];
+    interval = header[3];
+    distribution.resize(size);
+    std::memcpy(distribution.data(), pos, size * sizeof(double));
+    pos += size * sizeof(double);
+    cumulative.clear();
+    return true;
 }
\ No newline at end of file
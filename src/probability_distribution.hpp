@@ -2,33 +2,78 @@
 #define PROBABILITY_DISTRIBUTION_H
 
 #include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+// list of values and the chance of each one, used to describe the outcomes of a random event
+typedef std::vector<std::pair<int, double>> Chances;
 
 // class handle probability distributions, a discrete description is used to approximate a continuous distribution
-// the distribution starts at a minimum value up to a maximum value, with "bins" with a size
+// the distribution is a histogram of "bins" with a size, starting at the first bin and growing as values are added,
+// so the memory used depends only on the range of the values and not on how many there are
+// each bin holds a weight, which is the number of values for simulations and a probability for exact distributions
 // everything outside the range is given as 0
 // the distributions are not normalized
 class ProbabilityDistribution {
+    // value of the first bin
+    int start;
+    // smallest and largest values added
     int min;
     int max;
     int interval;
-    int* distribution;
-    int length;
-    int total;
+    std::vector<double> distribution;
+    // sum of all weights
+    double total;
+    // number of simulated values, 0 for exact distributions
+    std::uint64_t samples;
+
+    // running average and sum of squared deviations of the values, updated as values are added
+    double mean;
+    double squared_deviations;
+
+    // running sums of the weights, where `cumulative[i]` is the weight of the bins before `i`
+    // built on the first query after the distribution changes, so every range query after it is O(1)
+    std::vector<double> cumulative;
 
-    void build_dist (int* values, int size);
+    void add_bin (int value, double weight);
+
+    void build_cumulative ();
 
 public:
+    ProbabilityDistribution (int interval_value);
+
     ProbabilityDistribution (int interval_value, int* values, int size);
 
     ProbabilityDistribution (int min_value, int max_value, int interval_value, int* values, int size);
 
+    ProbabilityDistribution (const Chances& chances);
+
+    void add_value (int value);
+
+    void add_weight (int value, double weight);
+
+    void add (const ProbabilityDistribution& other);
+
+    void shift (int offset);
+
+    void scale (double factor);
+
+    void convolve (const ProbabilityDistribution& other);
+
     int get_distribution_pos (int value);
 
+    double get_total ();
+
+    std::uint64_t get_samples ();
+
     double get_chance (int min, int max);
 
     double get_chance_up_to (int max);
 
     double get_chance_from (int min);
+
+    int get_percentile (double fraction);
     
     double get_average ();
 
@@ -37,6 +82,12 @@ public:
     double get_stdev ();
 
     void export_dist (std::string name);
+
+    void export_binary (std::string name);
+
+    void write (std::string& buffer) const;
+
+    bool read (const char*& pos, const char* end);
 };
 
 #endif
\ No newline at end of file
@@ -1,7 +1,130 @@
-#include <cmath>
 #include "random.hpp"
 
+static inline std::uint64_t rotl (std::uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// the state is filled using splitmix64 so that similar seeds still give unrelated streams
+Random::Random (std::uint64_t seed) : mirror_mask(0) {
+    for (int i = 0; i < 4; i++) {
+        seed += 0x9e3779b97f4a7c15;
+        std::uint64_t z = seed;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        state[i] = z ^ (z >> 31);
+    }
+}
+
+// generates a random 64 bit integer
+std::uint64_t Random::next () {
+    std::uint64_t result = rotl(state[1] * 5, 7) * 9;
+    std::uint64_t t = state[1] << 17;
+
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+
+    state[2] ^= t;
+    state[3] = rotl(state[3], 45);
+
+    return result ^ mirror_mask;
+}
+
+// create a generator seeded from this one, which keeps the mirroring of this one
+Random Random::split () {
+    Random child(next() ^ mirror_mask);
+    child.mirror_mask = mirror_mask;
+    return child;
+}
+
+// turn the stream into its mirror (antithetic) image: every draw `x` becomes `2^64 - 1 - x`,
+// so every uniform `u` becomes `1 - u` and every event rolled with `chance` is swapped with its opposite end
+void Random::mirror () {
+    mirror_mask = ~mirror_mask;
+}
+
 // generates a random number between 0 and 1
-double Random::random_number() {
-    return (double)(rand()) / (double)(RAND_MAX);
+double Random::random_number () {
+    // the top 53 bits fill the whole mantissa of the double
+    return (double)(next() >> 11) * 0x1.0p-53;
+}
+
+// roll for an event, using a value from `threshold` to avoid converting the roll to a double
+bool Random::chance (std::uint64_t threshold) {
+    return next() < threshold;
+}
+
+// advance the generator by 2^128 steps, used to split a seed into non-overlapping streams
+void Random::jump () {
+    static const std::uint64_t jump_polynomial[] = {
+        0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c
+    };
+
+    std::uint64_t s0 = 0;
+    std::uint64_t s1 = 0;
+    std::uint64_t s2 = 0;
+    std::uint64_t s3 = 0;
+    for (std::uint64_t polynomial : jump_polynomial) {
+        for (int b = 0; b < 64; b++) {
+            if (polynomial & (std::uint64_t(1) << b)) {
+                s0 ^= state[0];
+                s1 ^= state[1];
+                s2 ^= state[2];
+                s3 ^= state[3];
+            }
+            next();
+        }
+    }
+    state[0] = s0;
+    state[1] = s1;
+    state[2] = s2;
+    state[3] = s3;
+}
+
+// every lane is seeded from a draw of the parent generator
+RandomLanes::RandomLanes (Random& rng) : rng(rng) {
+    for (int lane = 0; lane < size; lane++) {
+        Random lane_rng(rng.next());
+        for (int i = 0; i < 4; i++) {
+            // the first draws of a freshly seeded generator are its scrambled seed, which makes a good state
+            state[i][lane] = lane_rng.next();
+        }
+    }
+}
+
+// generates a random 64 bit integer for every lane
+void RandomLanes::next (std::uint64_t* out) {
+    #pragma omp simd
+    for (int lane = 0; lane < size; lane++) {
+        std::uint64_t s0 = state[0][lane];
+        std::uint64_t s1 = state[1][lane];
+        std::uint64_t s2 = state[2][lane];
+        std::uint64_t s3 = state[3][lane];
+
+        out[lane] = rotl(s1 * 5, 7) * 9;
+        std::uint64_t t = s1 << 17;
+
+        s2 ^= s0;
+        s3 ^= s1;
+        s1 ^= s2;
+        s0 ^= s3;
+        s2 ^= t;
+        s3 = rotl(s3, 45);
+
+        state[0][lane] = s0;
+        state[1][lane] = s1;
+        state[2][lane] = s2;
+        state[3][lane] = s3;
+    }
+}
+
+// generates a random number between 0 and 1 for every lane
+void RandomLanes::random_numbers (double* out) {
+    alignas(64) std::uint64_t values[size];
+    next(values);
+    #pragma omp simd
+    for (int lane = 0; lane < size; lane++) {
+        out[lane] = (double)(values[lane] >> 11) * 0x1.0p-53;
+    }
 }
\ No newline at end of file
@@ -1,10 +1,52 @@
 #ifndef RANDOM_H
 #define RANDOM_H
 
-// handle methods for generating random numbers
+#include <cstdint>
+
+// random number generator (xoshiro256**), every simulation stream owns one of these
+// what a simulation keeps besides its draws is in a `SampleContext`, and quasi-random draws come from `QuasiRandom`
 class Random {
+    std::uint64_t state[4];
+    // xor-ed into every output, all ones for a mirrored stream
+    std::uint64_t mirror_mask;
 public:
-    static double random_number ();
+    Random (std::uint64_t seed);
+
+    std::uint64_t next ();
+
+    Random split ();
+
+    void mirror ();
+
+    double random_number ();
+
+    bool chance (std::uint64_t threshold);
+
+    void jump ();
+
+    // convert a probability into the value `next` must be under for the event to happen
+    static constexpr std::uint64_t threshold (double probability) {
+        return static_cast<std::uint64_t>(probability * 0x1.0p64);
+    }
+};
+
+// several xoshiro256** generators advanced together for batched simulations
+// the state is stored lane by lane so that the loops over the lanes compile to SIMD instructions
+// (AVX2/AVX-512 when the target supports them, plain scalar code otherwise)
+class RandomLanes {
+public:
+    static const int size = 8;
+private:
+    alignas(64) std::uint64_t state[4][size];
+public:
+    // generator the lanes were seeded from, for code that has no batched version
+    Random& rng;
+
+    RandomLanes (Random& rng);
+
+    void next (std::uint64_t* out);
+
+    void random_numbers (double* out);
 };
 
 #endif
\ No newline at end of file
@@ -1,96 +1,475 @@
 #include <filesystem>
 #include <cmath>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
 #include "recording_reader.hpp"
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace fs = std::filesystem;
 
-RecordingReader::RecordingReader (std::string dir_path) : dir(dir_path) {}
+// read-only view of the contents of a file, mapped into memory instead of copied when the system allows it
+class FileView {
+    const char* data;
+    std::size_t size;
+    bool mapped;
+    // contents read the normal way if mapping failed
+    std::string copy;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+public:
+    FileView (const std::string& path) : data(nullptr), size(0), mapped(false) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        mapping = nullptr;
+        LARGE_INTEGER file_size;
+        if (file != INVALID_HANDLE_VALUE && GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping) {
+                data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                size = file_size.QuadPart;
+                mapped = data != nullptr;
+            }
+        }
+#else
+        int file = open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (file != -1 && fstat(file, &info) == 0 && info.st_size > 0) {
+            void* address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+            if (address != MAP_FAILED) {
+                data = static_cast<const char*>(address);
+                size = info.st_size;
+                mapped = true;
+            }
+        }
+        if (file != -1) close(file);
+#endif
+        if (!mapped) {
+            std::ifstream stream(path, std::ios::binary);
+            std::stringstream buffer;
+            buffer << stream.rdbuf();
+            copy = buffer.str();
+            data = copy.data();
+            size = copy.size();
+        }
+    }
 
-// create an object with the average times of all files in the directory
-Times RecordingReader::get_average () {
-    std::unordered_map<std::string, int> avg_map;
+    ~FileView () {
+#ifdef _WIN32
+        if (mapped) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (mapped) munmap(const_cast<char*>(data), size);
+#endif
+    }
 
-    bool is_first = true;
-    int total = 0;
-    for (const auto& entry : fs::directory_iterator(dir)) {
-        total++;
-        if (fs::is_regular_file(entry)) {
-            auto cur_map = read_file(entry.path().string());
-            if (is_first) {
-                avg_map = cur_map;
-                is_first = false;
-            } else {
-                for (const auto& pair : cur_map) {
-                    const std::string& key = pair.first;
-                    avg_map[key] += cur_map[key];
-                }
-            }
+    FileView (const FileView&) = delete;
+    FileView& operator= (const FileView&) = delete;
+
+    const char* begin () const { return data; }
+
+    const char* end () const { return data + size; }
+};
+
+// go through the `key=value;` pairs of a recording, calling `found(key, value)` for each one
+// the key is written into `key`, whose memory is reused between pairs, and the value is read in place
+template <typename Found>
+static void parse_recording (const char* pos, const char* end, std::string& key, Found found) {
+    while (pos < end) {
+        const char* key_end = std::find(pos, end, '=');
+        if (key_end == end) return;
+        key.assign(pos, key_end);
+        pos = key_end + 1;
+
+        const char* value_end = std::find(pos, end, ';');
+        if (value_end == end) return;
+        // same format as `std::stoi`: leading spaces, a sign and digits
+        while (pos < value_end && std::isspace((unsigned char) *pos)) pos++;
+        bool negative = pos < value_end && *pos == '-';
+        if (pos < value_end && (*pos == '-' || *pos == '+')) pos++;
+        int value = 0;
+        for (; pos < value_end && *pos >= '0' && *pos <= '9'; pos++) {
+            value = value * 10 + (*pos - '0');
         }
+        found(key, negative ? -value : value);
+        pos = value_end + 1;
     }
-    // divide everything by total to get average
-    for (const auto& pair : avg_map) {
-        const std::string& key = pair.first;
-        avg_map[key] = static_cast<int>(std::round((double)avg_map[key] / (double)total));
+}
+
+SegmentStats::SegmentStats () : count(0), mean(0), squared_deviations(0), best(0) {}
+
+void SegmentStats::add (int value) {
+    count++;
+    double delta = value - mean;
+    mean += delta / count;
+    squared_deviations += delta * (value - mean);
+    if (count == 1 || value < best) best = value;
+}
+
+void SegmentStats::remove (int value) {
+    if (count == 1) {
+        *this = SegmentStats();
+        return;
     }
+    double delta = value - mean;
+    count--;
+    mean -= delta / count;
+    squared_deviations -= delta * (value - mean);
+}
 
-    return avg_map;
+// sample variance, 0 for a single recording
+double SegmentStats::get_variance () const {
+    if (count < 2) return 0;
+    return squared_deviations / (count - 1);
 }
 
-// create an object with the fastest times in the directory
-Times RecordingReader::get_best () {
-    std::unordered_map<std::string, int> best_map;
+const char* const RecordingReader::cache_name = "recordings.cache";
 
-    bool is_first = true;
+// first bytes of the index file, changed whenever its layout changes
+static const char cache_magic[8] = { 'R', 'E', 'C', 'I', 'D', 'X', '0', '1' };
+
+RecordingReader::RecordingReader (std::string dir_path, int threads_value) :
+    dir(dir_path), threads(threads_value), loaded(false), stats_read(false) {}
+
+// the files the simulator keeps in the directory (like the index) end in ".cache", or ".cache.tmp" while being written
+bool RecordingReader::is_recording (const std::string& name) {
+    auto ends_with = [&name] (const std::string& suffix) {
+        return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    return !ends_with(".cache") && !ends_with(".cache.tmp");
+}
+
+// read the index if there is a valid one, keeping it as it was saved
+bool RecordingReader::load_cache (std::vector<Recording>& cached, std::vector<std::string>& cached_names) {
+    std::string path = (fs::path(dir) / cache_name).string();
+    if (!fs::exists(path)) return false;
+    FileView file(path);
+    const char* pos = file.begin();
+    const char* end = file.end();
+
+    // every read checks that the data is there, so a cut or corrupted index is only ignored
+    auto read = [&] (void* out, std::size_t size) {
+        if ((std::size_t) (end - pos) < size) return false;
+        std::copy(pos, pos + size, static_cast<char*>(out));
+        pos += size;
+        return true;
+    };
+    auto read_string = [&] (std::string& out) {
+        std::uint32_t length;
+        if (!read(&length, sizeof(length)) || (std::size_t) (end - pos) < length) return false;
+        out.assign(pos, pos + length);
+        pos += length;
+        return true;
+    };
+
+    char magic[sizeof(cache_magic)];
+    if (!read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), cache_magic)) return false;
+
+    std::uint32_t name_count;
+    if (!read(&name_count, sizeof(name_count))) return false;
+    cached_names.resize(name_count);
+    for (std::string& name : cached_names) {
+        if (!read_string(name)) return false;
+    }
+
+    std::uint32_t recording_count;
+    if (!read(&recording_count, sizeof(recording_count))) return false;
+    cached.resize(recording_count);
+    for (Recording& recording : cached) {
+        std::uint32_t value_count;
+        if (!read_string(recording.name) || !read(&recording.size, sizeof(recording.size)) ||
+            !read(&recording.modified, sizeof(recording.modified)) || !read(&value_count, sizeof(value_count))) return false;
+        recording.values.resize(value_count);
+        for (auto& value : recording.values) {
+            std::int32_t pair[2];
+            if (!read(pair, sizeof(pair)) || pair[0] < 0 || (std::uint32_t) pair[0] >= name_count) return false;
+            value = { pair[0], pair[1] };
+        }
+    }
+    return true;
+}
+
+// write the index next to the recordings, through a temporary file so that a reader never sees half of it
+// a directory that can't be written to just doesn't get an index
+void RecordingReader::save_cache () {
+    std::string path = (fs::path(dir) / cache_name).string();
+    std::string temporary_path = path + ".tmp";
+
+    // the whole index is put together in memory and written at once
+    std::string buffer;
+    auto write = [&] (const void* data, std::size_t size) {
+        buffer.append(static_cast<const char*>(data), size);
+    };
+    auto write_string = [&] (const std::string& text) {
+        std::uint32_t length = text.size();
+        write(&length, sizeof(length));
+        write(text.data(), length);
+    };
+
+    write(cache_magic, sizeof(cache_magic));
+    std::uint32_t name_count = segment_names.size();
+    write(&name_count, sizeof(name_count));
+    for (const std::string& name : segment_names) {
+        write_string(name);
+    }
+    std::uint32_t recording_count = recordings.size();
+    write(&recording_count, sizeof(recording_count));
+    for (const Recording& recording : recordings) {
+        write_string(recording.name);
+        write(&recording.size, sizeof(recording.size));
+        write(&recording.modified, sizeof(recording.modified));
+        std::uint32_t value_count = recording.values.size();
+        write(&value_count, sizeof(value_count));
+        for (const auto& value : recording.values) {
+            std::int32_t pair[2] = { value.first, value.second };
+            write(pair, sizeof(pair));
+        }
+    }
+
+    {
+        std::ofstream file(temporary_path, std::ios::binary);
+        if (!file) return;
+        file.write(buffer.data(), buffer.size());
+        if (!file) return;
+    }
+    std::error_code error;
+    fs::rename(temporary_path, path, error);
+    if (error) fs::remove(temporary_path, error);
+}
+
+// get every recording, from the index for the files it has in the same version, and parsing the rest
+// the files are sorted by name so that the results don't depend on the order of the directory
+void RecordingReader::load () {
+    if (loaded) return;
+
+    std::vector<Recording> cached;
+    std::vector<std::string> cached_names;
+    bool has_cache = load_cache(cached, cached_names);
+    std::unordered_map<std::string, Recording*> cached_by_name;
+    for (Recording& recording : cached) {
+        cached_by_name[recording.name] = &recording;
+    }
+
+    // the files of the directory, with the cached version of each if it's still the same
+    // (the size and time come with the directory listing on Windows, so they take no extra reads)
+    std::vector<Recording> files;
+    std::vector<Recording*> found;
     for (const auto& entry : fs::directory_iterator(dir)) {
-        if (fs::is_regular_file(entry)) {
-            auto cur_map = read_file(entry.path().string());
-            if (is_first) {
-                best_map = cur_map;
-                is_first = false;
-            } else {
-                for (const auto& pair : cur_map) {
-                    const std::string& key = pair.first;
-                    int cur_time = cur_map[key];
-                    if (cur_time < best_map[key]) best_map[key] = cur_time;
-                }
+        if (!entry.is_regular_file()) continue;
+        std::string name = entry.path().filename().string();
+        if (!is_recording(name)) continue;
+        Recording file;
+        file.name = name;
+        file.size = entry.file_size();
+        file.modified = entry.last_write_time().time_since_epoch().count();
+        files.push_back(file);
+    }
+    std::sort(files.begin(), files.end(), [] (const Recording& a, const Recording& b) { return a.name < b.name; });
+
+    std::vector<int> to_parse;
+    for (int i = 0; i < (int) files.size(); i++) {
+        auto cached_file = cached_by_name.find(files[i].name);
+        bool same = cached_file != cached_by_name.end()
+            && cached_file->second->size == files[i].size && cached_file->second->modified == files[i].modified;
+        found.push_back(same ? cached_file->second : nullptr);
+        if (!same) to_parse.push_back(i);
+    }
+
+    // the names of the index keep their numbers, and new ones are added after them
+    segment_names = cached_names;
+    std::unordered_map<std::string, int> name_ids;
+    for (int id = 0; id < (int) segment_names.size(); id++) {
+        name_ids[segment_names[id]] = id;
+    }
+    for (int i = 0; i < (int) files.size(); i++) {
+        if (found[i]) files[i].values = std::move(found[i]->values);
+    }
+
+    // the changed files are parsed by the workers, each numbering the names it finds on its own,
+    // and the numbers are then turned into the shared ones
+    std::vector<std::vector<std::string>> worker_names(threads);
+    int parse_count = to_parse.size();
+    #pragma omp parallel for schedule(static, 1) num_threads(threads)
+    for (int worker = 0; worker < threads; worker++) {
+        std::string key;
+        std::unordered_map<std::string, int> worker_ids;
+        for (int i = worker; i < parse_count; i += threads) {
+            Recording& file = files[to_parse[i]];
+            FileView view((fs::path(dir) / file.name).string());
+            parse_recording(view.begin(), view.end(), key, [&] (const std::string& name, int value) {
+                auto id = worker_ids.try_emplace(name, (int) worker_names[worker].size());
+                if (id.second) worker_names[worker].push_back(name);
+                file.values.push_back({ id.first->second, value });
+            });
+        }
+    }
+    for (int worker = 0; worker < threads; worker++) {
+        std::vector<int> shared_ids;
+        for (const std::string& name : worker_names[worker]) {
+            auto id = name_ids.try_emplace(name, (int) segment_names.size());
+            if (id.second) segment_names.push_back(name);
+            shared_ids.push_back(id.first->second);
+        }
+        for (int i = worker; i < parse_count; i += threads) {
+            for (auto& value : files[to_parse[i]].values) {
+                value.first = shared_ids[value.first];
             }
         }
     }
 
-    Times times(best_map);
+    recordings = std::move(files);
+    loaded = true;
+    if (!has_cache || parse_count > 0 || recordings.size() != cached.size()) save_cache();
+}
+
+// gather the statistics of every segment from the recordings
+const std::unordered_map<std::string, SegmentStats>& RecordingReader::get_stats () {
+    if (stats_read) return stats;
+    load();
+
+    std::vector<SegmentStats> segments(segment_names.size());
+    for (const Recording& recording : recordings) {
+        for (const auto& value : recording.values) {
+            segments[value.first].add(value.second);
+        }
+    }
+    for (int id = 0; id < (int) segment_names.size(); id++) {
+        if (segments[id].count > 0) stats[segment_names[id]] = segments[id];
+    }
+    stats_read = true;
+    return stats;
+}
+
+// the value of every recorded segment, either its average or its fastest time
+// every segment is averaged over the recordings that have it
+std::unordered_map<std::string, int> RecordingReader::get_values (bool best) {
+    std::unordered_map<std::string, int> values;
+    for (const auto& pair : get_stats()) {
+        values[pair.first] = best ? pair.second.best : static_cast<int>(std::round(pair.second.mean));
+    }
+    return values;
+}
 
-    return times;
+// create an object with the average times of all files in the directory
+Times RecordingReader::get_average () {
+    return get_values(false);
+}
+
+// create an object with the fastest times in the directory
+Times RecordingReader::get_best () {
+    return get_values(true);
+}
+
+// every recording in the directory on its own
+std::vector<std::unordered_map<std::string, int>> RecordingReader::read_all () {
+    load();
+    std::vector<std::unordered_map<std::string, int>> result;
+    for (const Recording& recording : recordings) {
+        std::unordered_map<std::string, int> map;
+        for (const auto& value : recording.values) {
+            map[segment_names[value.first]] = value.second;
+        }
+        result.push_back(map);
+    }
+    return result;
 }
 
 // read a file and generate a map with all its segments pointing to their time
 std::unordered_map<std::string, int> RecordingReader::read_file (std::string filePath) {
-    // getting all file content as a string
-    std::ifstream file(filePath);
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string content = buffer.str();
-
     std::unordered_map<std::string, int> map;
-    std::string key = "";
-    std::string value = "";
-    bool is_key = true;
-
-    for (char c : content) {
-        if (is_key) {
-            if (c == '=') is_key = false;
-            else key += c;
-        } else {
-            if (c == ';') {
-                is_key = true;
-                int time = std::stoi(value);
-                map[key] = time;
-                key = "";
-                value = "";
+    std::string key;
+    FileView file(filePath);
+    parse_recording(file.begin(), file.end(), key, [&] (const std::string& name, int value) {
+        map[name] = value;
+    });
+    return map;
+}
+
+// bring the recordings up to date with some files of the directory that were added, changed or removed, without listing it
+// the statistics are updated by taking out the old values of each file and adding the new ones
+// returns whether any recording changed
+bool RecordingReader::update (const std::vector<std::string>& names) {
+    get_stats();
+    std::unordered_map<std::string, int> name_ids;
+    for (int id = 0; id < (int) segment_names.size(); id++) {
+        name_ids[segment_names[id]] = id;
+    }
+
+    bool changed = false;
+    // the best time can't be taken out like the mean, so the segments that lost theirs are gathered again
+    std::vector<int> lost_best;
+    std::string key;
+    for (const std::string& name : names) {
+        if (!is_recording(name)) continue;
+        std::error_code error;
+        fs::directory_entry entry(fs::path(dir) / name, error);
+        bool exists = !error && entry.is_regular_file(error);
+        Recording file;
+        file.name = name;
+        if (exists) {
+            file.size = entry.file_size(error);
+            file.modified = entry.last_write_time(error).time_since_epoch().count();
+            exists = !error;
+        }
+
+        auto position = std::lower_bound(recordings.begin(), recordings.end(), name, [] (const Recording& recording, const std::string& target) {
+            return recording.name < target;
+        });
+        bool known = position != recordings.end() && position->name == name;
+        if (known && exists && position->size == file.size && position->modified == file.modified) continue;
+        changed = true;
+
+        if (known) {
+            for (const auto& value : position->values) {
+                SegmentStats& segment = stats[segment_names[value.first]];
+                segment.remove(value.second);
+                if (segment.count > 0 && value.second == segment.best) lost_best.push_back(value.first);
             }
-            else value += c;
+        }
+        if (exists) {
+            FileView view(entry.path().string());
+            parse_recording(view.begin(), view.end(), key, [&] (const std::string& segment_name, int value) {
+                auto id = name_ids.try_emplace(segment_name, (int) segment_names.size());
+                if (id.second) segment_names.push_back(segment_name);
+                file.values.push_back({ id.first->second, value });
+                stats[segment_name].add(value);
+            });
+            if (known) *position = std::move(file);
+            else recordings.insert(position, std::move(file));
+        } else if (known) {
+            recordings.erase(position);
         }
     }
+    if (!changed) return false;
 
-    return map;
-}
+    for (int id : lost_best) {
+        SegmentStats& segment = stats[segment_names[id]];
+        bool first = true;
+        for (const Recording& recording : recordings) {
+            for (const auto& value : recording.values) {
+                if (value.first != id) continue;
+                if (first || value.second < segment.best) segment.best = value.second;
+                first = false;
+            }
+        }
+    }
+    // segments left without recordings are the same as never recorded
+    for (auto segment = stats.begin(); segment != stats.end();) {
+        if (segment->second.count == 0) segment = stats.erase(segment);
+        else segment++;
+    }
+    save_cache();
+    return true;
+}
\ No newline at end of file
@@ -1,21 +1,83 @@
 #ifndef RECORDING_READER_H
 #define RECORDING_READER_H
 
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
 #include "times.hpp"
 
+// what the recordings say about a segment, gathered in a single pass
+struct SegmentStats {
+    // number of recordings with the segment
+    std::int64_t count;
+    double mean;
+    // sum of the squared deviations from the mean, for the variance
+    double squared_deviations;
+    int best;
+
+    SegmentStats ();
+
+    void add (int value);
+
+    // take out a value that was added, except from `best`
+    void remove (int value);
+
+    double get_variance () const;
+};
 
 // class that handles reading the recording files outputted by the mod
+// the parsed values are kept in an index file in the same directory, keyed by the name, size and modification time
+// of every file, so later runs only parse the files that are new or changed since then
 class RecordingReader {
     // path to directory where recording files are stored
     std::string dir;
+    // number of workers parsing the files
+    int threads;
+
+    // what was read from a recording file, with the values as (index in `segment_names`, value)
+    struct Recording {
+        std::string name;
+        std::uint64_t size;
+        std::int64_t modified;
+        std::vector<std::pair<int, int>> values;
+    };
+
+    // names of the segments and every recording, read the first time they are needed
+    std::vector<std::string> segment_names;
+    std::vector<Recording> recordings;
+    bool loaded;
+
+    // statistics of every segment, gathered from the recordings
+    std::unordered_map<std::string, SegmentStats> stats;
+    bool stats_read;
+
+    void load ();
+
+    bool load_cache (std::vector<Recording>& cached, std::vector<std::string>& cached_names);
+
+    void save_cache ();
 public:
-    RecordingReader (std::string dir_path);
+    // name of the index file, which is skipped when looking for recordings
+    static const char* const cache_name;
+
+    RecordingReader (std::string dir_path, int threads_value);
+
+    static bool is_recording (const std::string& name);
+
+    std::unordered_map<std::string, int> get_values (bool best);
 
     Times get_average ();
 
     Times get_best ();
 
+    const std::unordered_map<std::string, SegmentStats>& get_stats ();
+
+    std::vector<std::unordered_map<std::string, int>> read_all ();
+
     std::unordered_map<std::string, int> read_file (std::string filePath);
+
+    bool update (const std::vector<std::string>& names);
 };
 
 #endif
\ No newline at end of file
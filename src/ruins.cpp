@@ -2,44 +2,66 @@
 #include "undertale.hpp"
 #include "encounters.hpp"
 
-Ruins::Ruins (Times& times_value, bool glitchless, int first_half_kills) : Simulator(times_value), glitchless(glitchless), first_half_kills(first_half_kills) {}
+Ruins::Ruins (const Times& times_value, bool glitchless, int first_half_kills) : Simulator(times_value), glitchless(glitchless), first_half_kills(first_half_kills) {
+    times.require(Areas::Ruins);
+    if (glitchless) {
+        times.require_segment(Segments::RuinsDummyGlitchless);
+        times.require_segment(Segments::RuinsSpikes);
+    } else {
+        times.require_segment(Segments::RuinsTas);
+    }
+}
+
+Simulator* Ruins::clone (const Times& times_value) {
+    return new Ruins(times_value, glitchless, first_half_kills);
+}
+
+std::string Ruins::get_cache_key () {
+    return get_area_key(Areas::Ruins) + (glitchless ? " glitchless " : " tas ") + std::to_string(first_half_kills);
+}
 
-int Ruins::simulate() {
+template <typename Rng>
+int Ruins::simulate_draws (Rng& rng, SampleContext& context) {
     // initializing vars
+
+    // each half draws from its own generator, seeded before anything else, so that variants of the route
+    // (the start and the kills in the first half) still get the same random numbers in the parts they share
+    Rng first_half_rng = rng.split();
+    Rng second_half_rng = rng.split();
     
     // static time
-    int time = times.segments["ruins"];
-    time += Undertale::encounter_time_random(times.static_blcons["ruins"]);
+    int time = use_static_time(context, Areas::Ruins);
+    time += Undertale::encounter_time_random(rng, context, times.static_blcons[Areas::Ruins]);
 
     int kills = 0;
     int lv;
     int exp;
 
     if (glitchless) {
-        time += times.segments["ruins-dummy-glitchless"] + times.segments["ruins-spikes"] + Undertale::encounter_time_random();
+        time += use_segment(context, Segments::RuinsDummyGlitchless) + use_segment(context, Segments::RuinsSpikes) + Undertale::encounter_time_random(rng, context);
         lv = 2;
         exp = 10;
     } else {
-        time += times.segments["ruins-start-tas"];
+        time += use_segment(context, Segments::RuinsTas);
         lv = 1;
         exp = 0;
     }
 
     // static first half loop
     int first_half_loop = first_half_kills - 3;
-    time += first_half_loop * times.segments["ruins-first-transition"];
-    time += Undertale::encounter_time_random(first_half_loop);
+    time += use_segment(context, Segments::RuinsFirstTransition, first_half_loop);
+    time += Undertale::encounter_time_random(rng, context, first_half_loop);
     if (first_half_kills % 2 == 0) {
-        time += 2 * times.segments["ruins-first-transition"];
+        time += use_segment(context, Segments::RuinsFirstTransition, 2);
     }
 
     // loop for the first half
     while (kills < first_half_kills) {
-        int steps = Undertale::ruins_first_half_steps(kills);
+        int steps = Undertale::ruins_first_half_steps(first_half_rng, context, kills);
 
         // for first encounter, you need to at least get to the end of the room, requiring a step fix
         if (kills == 0) {
-            steps = fix_step_total(steps, "ruins-leaf-pile");
+            steps = fix_step_total(context, steps, Segments::RuinsLeafPile);
         }
         time += steps;
 
@@ -50,29 +72,29 @@ int Ruins::simulate() {
             lv = 3;
         }
 
-        int encounter = Undertale::ruins1();
+        int encounter = Undertale::ruins1(first_half_rng, context);
         // for the froggit encounter
         if (encounter == Encounters::SingleFroggit) {
             exp += 3;
-            bool two_turns = lv == 1 && Undertale::whiff_lv1_froggit();
+            bool two_turns = lv == 1 && Undertale::whiff_lv1_froggit(first_half_rng, context);
             if (lv == 1) {
                 if (two_turns) {
-                    time += times.segments["froggit-lv1-whiff"];
+                    time += use_segment(context, Segments::FroggitLv1Whiff);
                 } else {
-                    time += times.segments["froggit-lv1-no-whiff"];
+                    time += use_segment(context, Segments::FroggitLv1NoWhiff);
                 }
             } else if (lv == 2) {
-                time += times.segments["froggit-lv2"];
+                time += use_segment(context, Segments::FroggitLv2);
             } else {
-                time += times.segments["froggit-lv3"];
+                time += use_segment(context, Segments::FroggitLv3);
             }
-            time += times.segments["frogskip-save"] * Undertale::frogskip();
+            time += use_segment(context, Segments::FrogskipSave, Undertale::frogskip(first_half_rng, context));
             if (two_turns) {
-                time += times.segments["frogskip-save"] * Undertale::frogskip();
+                time += use_segment(context, Segments::FrogskipSave, Undertale::frogskip(first_half_rng, context));
             }
         // for whimsun
         } else {
-            time += times.segments["whim"];
+            time += use_segment(context, Segments::Whim);
             exp += 2;
         }
         kills++;
@@ -84,13 +106,13 @@ int Ruins::simulate() {
         if (second_half_count < 2) {
             second_half_count++;
         } else {
-            time += times.segments["ruins-second-transition"];
-            time += Undertale::encounter_time_random();
+            time += use_segment(context, Segments::RuinsSecondTransition);
+            time += Undertale::encounter_time_random(second_half_rng, context);
         }
 
-        time += Undertale::scr_steps(60, 60, 20, kills);;
+        time += Undertale::scr_steps(second_half_rng, context, 60, 60, 20, kills);;
 
-        int encounter = Undertale::ruins3();
+        int encounter = Undertale::ruins3(second_half_rng, context);
 
         bool at_18 = kills >= 18; 
         bool at_19 = kills >= 19;
@@ -102,28 +124,28 @@ int Ruins::simulate() {
         ) { // 2 monster encounters
             if (encounter == Encounters::FroggitWhimsun || encounter == Encounters::DoubleFroggit) { // for frog encounters
                 if (encounter == Encounters::FroggitWhimsun) { // for frog whim
-                    time += at_19 ? times.segments["frog-whim-19"] : times.segments["frog-whim"]; 
+                    time += at_19 ? use_segment(context, Segments::FrogWhim19) : use_segment(context, Segments::FrogWhim); 
                 } else { // for 2x frog
-                    time += at_19 ? times.segments["dbl-frog-19"] : times.segments["dbl-frog"];
+                    time += at_19 ? use_segment(context, Segments::DblFrog19) : use_segment(context, Segments::DblFrog);
                 }
                 // number of frog skips achievable depends on how many are being fought
                 for (int max = at_19 ? 1 : 2, i = 0; i < max; i++) {
-                    time += times.segments["frogskip-save"] * Undertale::frogskip();
+                    time += use_segment(context, Segments::FrogskipSave, Undertale::frogskip(second_half_rng, context));
                 }
             } else { // for 2x mold
-                time += at_19 ? times.segments["dbl-mold-19"] : times.segments["dbl-mold"];
+                time += at_19 ? use_segment(context, Segments::DblMold19) : use_segment(context, Segments::DblMold);
             }
             kills += 2;
         } else if (encounter == Encounters::SingleMoldsmal) { // single mold
-            time += times.segments["sgl-mold"];
+            time += use_segment(context, Segments::SglMold);
             kills++;
         } else { // triple mold
             if (at_18) {
-                time += times.segments["tpl-mold-18"];
+                time += use_segment(context, Segments::TplMold18);
             } else if (at_19) {
-                time += times.segments["tpl-mold-19"];
+                time += use_segment(context, Segments::TplMold19);
             } else {
-                time += times.segments["tpl-mold"];
+                time += use_segment(context, Segments::TplMold);
             }
             kills += 3;
         }
@@ -131,3 +153,303 @@ int Ruins::simulate() {
 
     return time;
 }
+
+int Ruins::simulate (Random& rng, SampleContext& context) {
+    return simulate_draws(rng, context);
+}
+
+int Ruins::simulate (QuasiRandom& rng, SampleContext& context) {
+    return simulate_draws(rng, context);
+}
+
+
+// same simulation as `simulate`, running all the lanes in lockstep
+void Ruins::simulate_batch (RandomLanes& lanes, int* results) {
+    const int size = RandomLanes::size;
+    alignas(64) int time[size];
+    alignas(64) int kills[size];
+    alignas(64) int lv[size];
+    alignas(64) int exp[size];
+    alignas(64) int steps[size];
+    alignas(64) int blcons[size];
+    alignas(64) int encounters[size];
+    alignas(64) std::uint64_t whiff_rolls[size];
+    alignas(64) std::uint64_t frogskip_rolls[size];
+    alignas(64) std::uint64_t second_frogskip_rolls[size];
+    const std::uint64_t whiff_threshold = Random::threshold(0.253);
+    const std::uint64_t frogskip_threshold = Random::threshold(0.405);
+
+    // segments are read once for the whole batch
+    int frogskip_save = times.segments[Segments::FrogskipSave];
+    int froggit_lv1_whiff = times.segments[Segments::FroggitLv1Whiff];
+    int froggit_lv1_no_whiff = times.segments[Segments::FroggitLv1NoWhiff];
+    int froggit_lv2 = times.segments[Segments::FroggitLv2];
+    int froggit_lv3 = times.segments[Segments::FroggitLv3];
+    int whim = times.segments[Segments::Whim];
+    int second_transition = times.segments[Segments::RuinsSecondTransition];
+
+    // static time, the same in every lane except for the blcons
+    int static_time = times.static_times[Areas::Ruins];
+    Undertale::encounter_time_random(lanes, times.static_blcons[Areas::Ruins], time);
+    int start_lv;
+    int start_exp;
+    if (glitchless) {
+        static_time += times.segments[Segments::RuinsDummyGlitchless] + times.segments[Segments::RuinsSpikes];
+        Undertale::encounter_time_random(lanes, 1, blcons);
+        for (int lane = 0; lane < size; lane++) time[lane] += blcons[lane];
+        start_lv = 2;
+        start_exp = 10;
+    } else {
+        static_time += times.segments[Segments::RuinsTas];
+        start_lv = 1;
+        start_exp = 0;
+    }
+
+    int first_half_loop = first_half_kills - 3;
+    static_time += first_half_loop * times.segments[Segments::RuinsFirstTransition];
+    Undertale::encounter_time_random(lanes, first_half_loop, blcons);
+    if (first_half_kills % 2 == 0) {
+        static_time += 2 * times.segments[Segments::RuinsFirstTransition];
+    }
+
+    for (int lane = 0; lane < size; lane++) {
+        time[lane] += static_time + blcons[lane];
+        kills[lane] = 0;
+        lv[lane] = start_lv;
+        exp[lane] = start_exp;
+    }
+
+    // first half, every lane gets one kill per encounter so they never get out of step
+    for (int kill = 0; kill < first_half_kills; kill++) {
+        Undertale::scr_steps(lanes, 80, 40, 20, kills, steps);
+        if (kill == 0) {
+            for (int lane = 0; lane < size; lane++) {
+                steps[lane] = fix_step_total(steps[lane], Segments::RuinsLeafPile);
+            }
+        }
+
+        Undertale::ruins1(lanes, encounters);
+        lanes.next(whiff_rolls);
+        lanes.next(frogskip_rolls);
+        lanes.next(second_frogskip_rolls);
+
+        #pragma omp simd
+        for (int lane = 0; lane < size; lane++) {
+            if (exp[lane] >= 10) lv[lane] = 2;
+
+            bool froggit = encounters[lane] == Encounters::SingleFroggit;
+            bool two_turns = lv[lane] == 1 && whiff_rolls[lane] < whiff_threshold;
+            int froggit_time = lv[lane] == 1
+                ? (two_turns ? froggit_lv1_whiff : froggit_lv1_no_whiff)
+                : (lv[lane] == 2 ? froggit_lv2 : froggit_lv3);
+            froggit_time += frogskip_save * (frogskip_rolls[lane] >= frogskip_threshold);
+            froggit_time += two_turns ? frogskip_save * (second_frogskip_rolls[lane] >= frogskip_threshold) : 0;
+
+            time[lane] += steps[lane] + (froggit ? froggit_time : whim);
+            exp[lane] += froggit ? 3 : 2;
+            kills[lane]++;
+        }
+    }
+
+    // tables for the second half encounters, the columns being below 18 kills, at 18 kills and at 19 kills
+    int encounter_times[Encounters::EncounterCount][3] = {};
+    int frogs[Encounters::EncounterCount][3] = {};
+    int encounter_kills[Encounters::EncounterCount] = {};
+    int frog_whim[3] = { times.segments[Segments::FrogWhim], times.segments[Segments::FrogWhim], times.segments[Segments::FrogWhim19] };
+    int dbl_frog[3] = { times.segments[Segments::DblFrog], times.segments[Segments::DblFrog], times.segments[Segments::DblFrog19] };
+    int dbl_mold[3] = { times.segments[Segments::DblMold], times.segments[Segments::DblMold], times.segments[Segments::DblMold19] };
+    int tpl_mold[3] = { times.segments[Segments::TplMold], times.segments[Segments::TplMold18], times.segments[Segments::TplMold18] };
+    for (int column = 0; column < 3; column++) {
+        encounter_times[Encounters::FroggitWhimsun][column] = frog_whim[column];
+        encounter_times[Encounters::DoubleFroggit][column] = dbl_frog[column];
+        encounter_times[Encounters::DoubleMoldsmal][column] = dbl_mold[column];
+        encounter_times[Encounters::SingleMoldsmal][column] = times.segments[Segments::SglMold];
+        encounter_times[Encounters::TripleMoldsmal][column] = tpl_mold[column];
+        frogs[Encounters::FroggitWhimsun][column] = column == 2 ? 1 : 2;
+        frogs[Encounters::DoubleFroggit][column] = column == 2 ? 1 : 2;
+    }
+    encounter_kills[Encounters::FroggitWhimsun] = 2;
+    encounter_kills[Encounters::DoubleFroggit] = 2;
+    encounter_kills[Encounters::DoubleMoldsmal] = 2;
+    encounter_kills[Encounters::SingleMoldsmal] = 1;
+    encounter_kills[Encounters::TripleMoldsmal] = 3;
+
+    // second half, lanes that reach 20 kills are masked off until all of them are done
+    alignas(64) int second_half_count[size] = {};
+    bool any_active = true;
+    while (any_active) {
+        Undertale::encounter_time_random(lanes, 1, blcons);
+        Undertale::scr_steps(lanes, 60, 60, 20, kills, steps);
+        Undertale::ruins3(lanes, encounters);
+        lanes.next(frogskip_rolls);
+        lanes.next(second_frogskip_rolls);
+
+        any_active = false;
+        #pragma omp simd
+        for (int lane = 0; lane < size; lane++) {
+            bool active = kills[lane] < 20;
+            // first two encounters have STATIC values
+            int transition = second_half_count[lane] < 2 ? 0 : second_transition + blcons[lane];
+            int column = kills[lane] >= 19 ? 2 : (kills[lane] >= 18 ? 1 : 0);
+            int encounter = encounters[lane];
+            int frog_count = frogs[encounter][column];
+            int frogskips = (frog_count >= 1) * (frogskip_rolls[lane] >= frogskip_threshold)
+                + (frog_count >= 2) * (second_frogskip_rolls[lane] >= frogskip_threshold);
+
+            int encounter_time = transition + steps[lane] + encounter_times[encounter][column] + frogskip_save * frogskips;
+            time[lane] += active ? encounter_time : 0;
+            kills[lane] += active ? encounter_kills[encounter] : 0;
+            second_half_count[lane] += active;
+        }
+        for (int lane = 0; lane < size; lane++) {
+            any_active = any_active || kills[lane] < 20;
+        }
+    }
+
+    for (int lane = 0; lane < size; lane++) {
+        results[lane] = time[lane];
+    }
+}
+
+// same as `simulate`, but following every branch with its chance to get the exact distribution
+// the first half is tracked by LV and EXP, and the second half by kills and how many encounters were done
+ProbabilityDistribution Ruins::get_exact_dist () {
+    ProbabilityDistribution time = Undertale::encounter_time_chances(times.static_blcons[Areas::Ruins]);
+    time.shift(times.static_times[Areas::Ruins]);
+
+    int start_lv;
+    int start_exp;
+    if (glitchless) {
+        time.shift(times.segments[Segments::RuinsDummyGlitchless] + times.segments[Segments::RuinsSpikes]);
+        time.convolve(Undertale::encounter_time_chances(1));
+        start_lv = 2;
+        start_exp = 10;
+    } else {
+        time.shift(times.segments[Segments::RuinsTas]);
+        start_lv = 1;
+        start_exp = 0;
+    }
+
+    int first_half_loop = first_half_kills - 3;
+    time.shift(first_half_loop * times.segments[Segments::RuinsFirstTransition]);
+    time.convolve(Undertale::encounter_time_chances(first_half_loop));
+    if (first_half_kills % 2 == 0) {
+        time.shift(2 * times.segments[Segments::RuinsFirstTransition]);
+    }
+
+    // time saved by the frogskips when fighting one or two froggits
+    ProbabilityDistribution one_frogskip(1);
+    for (const auto& frogskip : Undertale::frogskip_chances()) {
+        one_frogskip.add_weight(frogskip.first * times.segments[Segments::FrogskipSave], frogskip.second);
+    }
+    ProbabilityDistribution two_frogskips = one_frogskip;
+    two_frogskips.convolve(one_frogskip);
+
+    // first half, every encounter is one kill
+    std::map<std::pair<int, int>, ProbabilityDistribution> first_half;
+    first_half.emplace(std::make_pair(start_lv, start_exp), time);
+    for (int kills = 0; kills < first_half_kills; kills++) {
+        Chances step_chances = Undertale::ruins_first_half_steps_chances(kills);
+        ProbabilityDistribution steps = kills == 0
+            ? fix_step_chances(step_chances, Segments::RuinsLeafPile)
+            : ProbabilityDistribution(step_chances);
+
+        std::map<std::pair<int, int>, ProbabilityDistribution> next_first_half;
+        for (const auto& [state, dist] : first_half) {
+            int lv = state.first;
+            int exp = state.second;
+            if (exp >= 10) lv = 2;
+
+            ProbabilityDistribution walked = dist;
+            walked.convolve(steps);
+            for (const auto& encounter : Undertale::ruins1_chances()) {
+                if (encounter.first == Encounters::SingleFroggit) {
+                    if (lv == 1) {
+                        double whiff = Undertale::whiff_lv1_froggit_chance();
+                        ProbabilityDistribution two_turns = walked;
+                        two_turns.shift(times.segments[Segments::FroggitLv1Whiff]);
+                        two_turns.convolve(two_frogskips);
+                        two_turns.scale(encounter.second * whiff);
+                        add_state(next_first_half, { lv, exp + 3 }, two_turns);
+
+                        ProbabilityDistribution one_turn = walked;
+                        one_turn.shift(times.segments[Segments::FroggitLv1NoWhiff]);
+                        one_turn.convolve(one_frogskip);
+                        one_turn.scale(encounter.second * (1 - whiff));
+                        add_state(next_first_half, { lv, exp + 3 }, one_turn);
+                    } else {
+                        ProbabilityDistribution froggit = walked;
+                        froggit.shift(lv == 2 ? times.segments[Segments::FroggitLv2] : times.segments[Segments::FroggitLv3]);
+                        froggit.convolve(one_frogskip);
+                        froggit.scale(encounter.second);
+                        add_state(next_first_half, { lv, exp + 3 }, froggit);
+                    }
+                } else {
+                    ProbabilityDistribution whimsun = walked;
+                    whimsun.shift(times.segments[Segments::Whim]);
+                    whimsun.scale(encounter.second);
+                    add_state(next_first_half, { lv, exp + 2 }, whimsun);
+                }
+            }
+        }
+        first_half = next_first_half;
+    }
+
+    // second half, the states are visited in order of kills, and only the first two encounters are special
+    std::map<std::pair<int, int>, ProbabilityDistribution> second_half;
+    for (const auto& [state, dist] : first_half) {
+        add_state(second_half, { first_half_kills, 0 }, dist);
+    }
+    ProbabilityDistribution result(1);
+    for (const auto& [state, dist] : second_half) {
+        int kills = state.first;
+        int second_half_count = state.second;
+        if (kills >= 20) {
+            result.add(dist);
+            continue;
+        }
+
+        ProbabilityDistribution walked = dist;
+        if (second_half_count >= 2) {
+            walked.shift(times.segments[Segments::RuinsSecondTransition]);
+            walked.convolve(Undertale::encounter_time_chances(1));
+        }
+        walked.convolve(ProbabilityDistribution(Undertale::scr_steps_chances(60, 60, 20, kills)));
+        int next_count = std::min(second_half_count + 1, 2);
+
+        bool at_18 = kills >= 18;
+        bool at_19 = kills >= 19;
+        for (const auto& encounter : Undertale::ruins3_chances()) {
+            ProbabilityDistribution branch = walked;
+            int encounter_kills;
+            if (encounter.first == Encounters::FroggitWhimsun) {
+                branch.shift(at_19 ? times.segments[Segments::FrogWhim19] : times.segments[Segments::FrogWhim]);
+                branch.convolve(at_19 ? one_frogskip : two_frogskips);
+                encounter_kills = 2;
+            } else if (encounter.first == Encounters::DoubleFroggit) {
+                branch.shift(at_19 ? times.segments[Segments::DblFrog19] : times.segments[Segments::DblFrog]);
+                branch.convolve(at_19 ? one_frogskip : two_frogskips);
+                encounter_kills = 2;
+            } else if (encounter.first == Encounters::DoubleMoldsmal) {
+                branch.shift(at_19 ? times.segments[Segments::DblMold19] : times.segments[Segments::DblMold]);
+                encounter_kills = 2;
+            } else if (encounter.first == Encounters::SingleMoldsmal) {
+                branch.shift(times.segments[Segments::SglMold]);
+                encounter_kills = 1;
+            } else {
+                if (at_18) {
+                    branch.shift(times.segments[Segments::TplMold18]);
+                } else if (at_19) {
+                    branch.shift(times.segments[Segments::TplMold19]);
+                } else {
+                    branch.shift(times.segments[Segments::TplMold]);
+                }
+                encounter_kills = 3;
+            }
+            branch.scale(encounter.second);
+            add_state(second_half, { kills + encounter_kills, next_count }, branch);
+        }
+    }
+
+    return result;
+}
\ No newline at end of file
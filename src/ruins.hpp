@@ -7,13 +7,27 @@
 class Ruins : public Simulator {
 
 public:
-    Ruins (Times& times_value, bool glitchless, int first_half_kills);
+    Ruins (const Times& times_value, bool glitchless, int first_half_kills);
 
-    int simulate() override;
+    int simulate (Random& rng, SampleContext& context) override;
+
+    int simulate (QuasiRandom& rng, SampleContext& context) override;
+
+    void simulate_batch (RandomLanes& lanes, int* results) override;
+
+    ProbabilityDistribution get_exact_dist () override;
+
+    Simulator* clone (const Times& times_value) override;
+
+    std::string get_cache_key () override;
 
     bool glitchless;
 
     int first_half_kills;
+
+private:
+    template <typename Rng>
+    int simulate_draws (Rng& rng, SampleContext& context);
 };
 
 #endif
\ No newline at end of file
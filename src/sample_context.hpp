@@ -0,0 +1,41 @@
+#ifndef SAMPLE_CONTEXT_H
+#define SAMPLE_CONTEXT_H
+
+#include <cstdint>
+
+struct DrawRecord;
+struct SampleUsage;
+
+// random parts of a simulation whose average is known, used as control variates
+namespace Controls {
+    enum {
+        // time of the blcon animations
+        Blcons,
+        // steps taken before the encounters
+        Steps,
+        Count
+    };
+}
+
+// what a simulation keeps track of besides its draws, for the modes that need it
+// it is given along with the random draws to everything a simulation runs, and shared by every part of the simulation
+struct SampleContext {
+    // running totals of the parts in `Controls`, minus their average, so they are expected to be 0
+    // their correlation with the simulated time is what lets the control variates remove part of its noise
+    double controls[Controls::Count];
+
+    // random encounters rolled so far, for exporting the samples
+    std::int64_t encounters;
+
+    // for usage models: where the segments read by the simulation are counted (none by default)
+    SampleUsage* usage;
+
+    // for importance sampling: the chances the draws are taken from instead of the real ones (none by default),
+    // and the product of the likelihood ratios of the draws so far, which is the weight of the simulation
+    DrawRecord* record;
+    double weight;
+
+    SampleContext () : controls(), encounters(0), usage(nullptr), record(nullptr), weight(1) {}
+};
+
+#endif
\ No newline at end of file
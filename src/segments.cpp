@@ -0,0 +1,75 @@
+#include "segments.hpp"
+
+// must be in the same order as `Segments`
+const SegmentInfo segment_info[Segments::Count] = {
+    // ruins
+    { "ruins-tas", Areas::None },
+    { "ruins-dummy-glitchless", Areas::None },
+    { "ruins-spikes", Areas::None },
+    { "ruins-leaf-pile", Areas::Ruins },
+    { "ruins-first-transition", Areas::Ruins },
+    { "froggit-lv1-whiff", Areas::Ruins },
+    { "froggit-lv1-no-whiff", Areas::Ruins },
+    { "froggit-lv2", Areas::Ruins },
+    { "froggit-lv3", Areas::Ruins },
+    // computed in the time structure, required through the two segments below
+    { "frogskip-save", Areas::None },
+    { "frogskip", Areas::Ruins },
+    { "not-frogskip", Areas::Ruins },
+    { "whim", Areas::Ruins },
+    { "ruins-second-transition", Areas::Ruins },
+    { "sgl-mold", Areas::Ruins },
+    { "dbl-mold", Areas::Ruins },
+    { "dbl-mold-19", Areas::Ruins },
+    { "tpl-mold", Areas::Ruins },
+    { "tpl-mold-18", Areas::Ruins },
+    { "tpl-mold-19", Areas::Ruins },
+    { "frog-whim", Areas::Ruins },
+    { "frog-whim-19", Areas::Ruins },
+    { "dbl-frog", Areas::Ruins },
+    { "dbl-frog-19", Areas::Ruins },
+    // snowdin
+    { "snowdin-box-road", Areas::Snowdin },
+    { "snowdin-dogi", Areas::Snowdin },
+    { "snowdin-right-transition", Areas::Snowdin },
+    { "snowdin-left-transition", Areas::Snowdin },
+    { "snowdin-dbl", Areas::Snowdin },
+    { "snowdin-tpl", Areas::Snowdin },
+    { "snowdin-dbl-jerry", Areas::Snowdin },
+    { "snowdin-tpl-jerry", Areas::Snowdin },
+    // waterfall
+    { "sgl-woshua-shoes", Areas::Waterfall },
+    { "sgl-aaron-shoes", Areas::Waterfall },
+    { "woshua-aaron-surprise", Areas::Waterfall },
+    { "dbl-mold-shoes", Areas::Waterfall },
+    { "temmie", Areas::Waterfall },
+    { "woshua-mold", Areas::Waterfall },
+    { "woshua-mold-17", Areas::Waterfall },
+    { "woshua-aaron-17", Areas::Waterfall },
+    { "mushroom-maze", Areas::Waterfall },
+    { "mushroom-maze-going-back", Areas::Waterfall },
+    { "mushroom-maze-exit-after-backtrack", Areas::Waterfall },
+    { "crystal-maze", Areas::Waterfall },
+    { "crystal-going-back", Areas::Waterfall },
+    { "crystal-exit-after-backtrack", Areas::Waterfall },
+    // endgame
+    { "core-right-transition", Areas::Endgame },
+    { "core-left-side-transition-2", Areas::Endgame },
+    { "core-left-side-transition-3", Areas::Endgame },
+    { "grind-end-transition", Areas::Endgame },
+    { "frog-astig", Areas::Endgame },
+    { "frog-astig-flee", Areas::Endgame },
+    { "whim-astig", Areas::Endgame },
+    { "whim-astig-flee", Areas::Endgame },
+    { "core-frog-whim", Areas::Endgame },
+    { "core-frog-whim-flee", Areas::Endgame },
+    { "core-triple", Areas::Endgame },
+    { "core-triple-kill-one", Areas::Endgame },
+    { "core-triple-kill-two", Areas::Endgame },
+    { "sgl-knight", Areas::Endgame },
+    { "sgl-madjick", Areas::Endgame },
+    { "nobody-came", Areas::Endgame },
+    { "core-bridge", Areas::Endgame }
+};
+
+const char* const area_names[Areas::Count] = { "ruins", "snowdin", "waterfall", "endgame" };
\ No newline at end of file
@@ -0,0 +1,104 @@
+#ifndef SEGMENTS_H
+#define SEGMENTS_H
+
+// ids for the areas of the run
+namespace Areas {
+    enum {
+        Ruins,
+        Snowdin,
+        Waterfall,
+        Endgame,
+        // number of areas
+        Count,
+        // for segments that are only needed by some route choices
+        None = -1
+    };
+}
+
+// ids for every segment the simulators read, so that the names are only looked up once when `Times` is built
+namespace Segments {
+    enum {
+        // ruins
+        RuinsTas,
+        RuinsDummyGlitchless,
+        RuinsSpikes,
+        RuinsLeafPile,
+        RuinsFirstTransition,
+        FroggitLv1Whiff,
+        FroggitLv1NoWhiff,
+        FroggitLv2,
+        FroggitLv3,
+        FrogskipSave,
+        Frogskip,
+        NotFrogskip,
+        Whim,
+        RuinsSecondTransition,
+        SglMold,
+        DblMold,
+        DblMold19,
+        TplMold,
+        TplMold18,
+        TplMold19,
+        FrogWhim,
+        FrogWhim19,
+        DblFrog,
+        DblFrog19,
+        // snowdin
+        SnowdinBoxRoad,
+        SnowdinDogi,
+        SnowdinRightTransition,
+        SnowdinLeftTransition,
+        SnowdinDbl,
+        SnowdinTpl,
+        SnowdinDblJerry,
+        SnowdinTplJerry,
+        // waterfall
+        SglWoshuaShoes,
+        SglAaronShoes,
+        WoshuaAaronSurprise,
+        DblMoldShoes,
+        Temmie,
+        WoshuaMold,
+        WoshuaMold17,
+        WoshuaAaron17,
+        MushroomMaze,
+        MushroomMazeGoingBack,
+        MushroomMazeExitAfterBacktrack,
+        CrystalMaze,
+        CrystalGoingBack,
+        CrystalExitAfterBacktrack,
+        // endgame
+        CoreRightTransition,
+        CoreLeftSideTransition2,
+        CoreLeftSideTransition3,
+        GrindEndTransition,
+        FrogAstig,
+        FrogAstigFlee,
+        WhimAstig,
+        WhimAstigFlee,
+        CoreFrogWhim,
+        CoreFrogWhimFlee,
+        CoreTriple,
+        CoreTripleKillOne,
+        CoreTripleKillTwo,
+        SglKnight,
+        SglMadjick,
+        NobodyCame,
+        CoreBridge,
+        // number of segments
+        Count
+    };
+}
+
+// name of a segment in the recordings and the area that needs it
+struct SegmentInfo {
+    const char* name;
+    int area;
+};
+
+extern const SegmentInfo segment_info[Segments::Count];
+
+// name of each area in the time structure
+extern const char* const area_names[Areas::Count];
+
+#endif
\ No newline at end of file
@@ -0,0 +1,269 @@
+#include <sstream>
+#include <stdexcept>
+#include "server.hpp"
+#include "simulator.hpp"
+#include "ruins.hpp"
+#include "snowdin.hpp"
+#include "waterfall.hpp"
+#include "endgame.hpp"
+#include "full_game.hpp"
+#include "utils.hpp"
+
+namespace {
+    // a value of a query, kept as text: strings without their quotes, and the items of arrays
+    struct Value {
+        std::string text;
+        std::vector<std::string> items;
+    };
+
+    // reader for the flat objects of the queries: strings, numbers, booleans and arrays of them
+    class QueryParser {
+        const std::string& line;
+        size_t pos;
+
+        void skip_spaces () {
+            while (pos < line.size() && isspace((unsigned char) line[pos])) pos++;
+        }
+
+        void expect (char c) {
+            skip_spaces();
+            if (pos >= line.size() || line[pos] != c) throw std::runtime_error(std::string("expected '") + c + "'");
+            pos++;
+        }
+
+        bool next_is (char c) {
+            skip_spaces();
+            return pos < line.size() && line[pos] == c;
+        }
+
+        std::string read_scalar () {
+            skip_spaces();
+            if (pos < line.size() && line[pos] == '"') {
+                pos++;
+                std::string text;
+                while (pos < line.size() && line[pos] != '"') {
+                    if (line[pos] == '\\' && pos + 1 < line.size()) pos++;
+                    text += line[pos++];
+                }
+                expect('"');
+                return text;
+            }
+            size_t start = pos;
+            while (pos < line.size() && line[pos] != ',' && line[pos] != '}' && line[pos] != ']' && !isspace((unsigned char) line[pos])) {
+                pos++;
+            }
+            if (start == pos) throw std::runtime_error("expected a value");
+            return line.substr(start, pos - start);
+        }
+
+    public:
+        QueryParser (const std::string& line_value) : line(line_value), pos(0) {}
+
+        std::map<std::string, Value> parse () {
+            std::map<std::string, Value> fields;
+            expect('{');
+            if (next_is('}')) return fields;
+            do {
+                std::string key = read_scalar();
+                expect(':');
+                Value& value = fields[key];
+                if (next_is('[')) {
+                    pos++;
+                    if (!next_is(']')) {
+                        do value.items.push_back(read_scalar()); while (next_is(',') && ++pos);
+                    }
+                    expect(']');
+                } else {
+                    value.text = read_scalar();
+                }
+            } while (next_is(',') && ++pos);
+            expect('}');
+            return fields;
+        }
+    };
+
+    std::string escape (const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+}
+
+Server::Entry::Entry () : ready(false), dist(1) {}
+
+// the options a simulator ignores are left out, so the queries that only differ in them share a distribution
+std::string Server::Config::get_key () const {
+    std::ostringstream key;
+    key << run << (best ? " best" : " average");
+    if (run == "ruins") key << (tas ? " tas " : " glitchless ") << first_half_kills;
+    if (exact) key << " exact";
+    else key << " " << simulations << " " << seed << (batched ? " batched" : "");
+    return key.str();
+}
+
+Server::Server (RecordingReader& reader_value, int threads_value, std::int64_t simulations_value, std::uint64_t seed_value) :
+    reader(reader_value), threads(threads_value), simulations(simulations_value), seed(seed_value), stopping(false) {
+    if (threads < 1) throw std::runtime_error("the number of threads must be at least 1");
+    average = reader.get_average();
+    best = reader.get_best();
+    worker = std::thread(&Server::work, this);
+}
+
+Server::~Server () {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    worker.join();
+}
+
+// simulate the jobs one at a time, each one using every thread
+void Server::work () {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        const Config& config = job.config;
+        ProbabilityDistribution dist(1);
+        std::string error;
+        Simulator* simulator = nullptr;
+        try {
+            if (config.run == "ruins") simulator = new Ruins(job.times, !config.tas, config.first_half_kills);
+            else if (config.run == "snowdin") simulator = new Snowdin(job.times);
+            else if (config.run == "waterfall") simulator = new Waterfall(job.times);
+            else if (config.run == "endgame") simulator = new Endgame(job.times);
+            else if (config.run == "full") simulator = new FullGame(job.times);
+            else throw std::runtime_error("unknown run \"" + config.run + "\"");
+
+            if (config.exact) dist = simulator->get_exact_dist();
+            else dist = simulator->get_dist(config.simulations, threads, config.seed, config.batched);
+        } catch (const std::exception& exception) {
+            error = exception.what();
+        }
+        delete simulator;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job.entry->dist = dist;
+            job.entry->error = error;
+            job.entry->ready = true;
+        }
+        changed.notify_all();
+    }
+}
+
+// a query has the options of the distribution (like in the command line) and what to read from it, for example
+// {"id": 1, "run": "full", "best": true, "max": "37:00", "chance": true, "percentiles": [10, 50, 90]}
+std::string Server::answer (const std::string& line) {
+    std::map<std::string, Value> fields;
+    std::string id = "null";
+    try {
+        fields = QueryParser(line).parse();
+    } catch (const std::runtime_error& error) {
+        return std::string("{\"id\": null, \"status\": \"error\", \"error\": \"") + escape(error.what()) + "\"}";
+    }
+    // ids are given back as strings
+    auto id_field = fields.find("id");
+    if (id_field != fields.end()) id = "\"" + escape(id_field->second.text) + "\"";
+
+    auto text = [&] (const std::string& name, const std::string& fallback) {
+        auto field = fields.find(name);
+        return field == fields.end() ? fallback : field->second.text;
+    };
+    auto flag = [&] (const std::string& name) {
+        return text(name, "false") == "true";
+    };
+
+    std::ostringstream response;
+    response.precision(10);
+    response << "{\"id\": " << id;
+    try {
+        Config config;
+        config.run = text("run", "");
+        config.best = flag("best");
+        config.tas = flag("tas");
+        config.first_half_kills = std::stoi(text("kills", "13"));
+        config.simulations = std::stoll(text("simulations", std::to_string(simulations)));
+        config.seed = std::stoull(text("seed", std::to_string(seed)));
+        config.exact = flag("exact");
+        config.batched = flag("batch");
+        // checked before the query gets an entry, so a bad query doesn't leave one behind
+        if (config.simulations <= 0) throw std::runtime_error("simulations must be positive");
+        // the first half of the ruins starts with 3 kills and can't go past the 20 kills of the ruins
+        if (config.first_half_kills < 3 || config.first_half_kills > 20) {
+            throw std::runtime_error("kills must be between 3 and 20");
+        }
+
+        std::shared_ptr<Entry> entry;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            std::shared_ptr<Entry>& cached = entries[config.get_key()];
+            if (!cached) {
+                cached = std::make_shared<Entry>();
+                jobs.push_back({ config, config.best ? best : average, cached });
+                changed.notify_all();
+            }
+            entry = cached;
+            // without waiting, the query is answered as pending and can be repeated later
+            if (flag("wait")) changed.wait(lock, [&entry] { return entry->ready; });
+            if (!entry->ready) return response.str() + ", \"status\": \"pending\"}";
+        }
+        if (!entry->error.empty()) throw std::runtime_error(entry->error);
+
+        ProbabilityDistribution& dist = entry->dist;
+        int min = fields.count("min") ? Utils::parse_frames(fields["min"].text) : -1;
+        int max = fields.count("max") ? Utils::parse_frames(fields["max"].text) : -1;
+        response << ", \"status\": \"ready\", \"simulations\": " << dist.get_samples();
+        if (flag("chance")) {
+            double chance = 1;
+            if (min != -1 && max != -1) chance = dist.get_chance(min, max);
+            else if (min != -1) chance = dist.get_chance_from(min);
+            else if (max != -1) chance = dist.get_chance_up_to(max);
+            response << ", \"chance\": " << chance;
+        }
+        if (flag("average")) response << ", \"average\": " << dist.get_average();
+        if (flag("stdev")) response << ", \"stdev\": " << dist.get_stdev();
+        // times are given in frames
+        if (fields.count("under")) {
+            response << ", \"under\": [";
+            const std::vector<std::string>& thresholds = fields["under"].items;
+            for (size_t i = 0; i < thresholds.size(); i++) {
+                response << (i ? ", " : "") << dist.get_chance_up_to(Utils::parse_frames(thresholds[i]));
+            }
+            response << "]";
+        }
+        if (fields.count("percentiles")) {
+            response << ", \"percentiles\": [";
+            const std::vector<std::string>& percentiles = fields["percentiles"].items;
+            for (size_t i = 0; i < percentiles.size(); i++) {
+                response << (i ? ", " : "") << dist.get_percentile(std::stod(percentiles[i]) / 100);
+            }
+            response << "]";
+        }
+    } catch (const std::exception& error) {
+        std::ostringstream failed;
+        failed << "{\"id\": " << id << ", \"status\": \"error\", \"error\": \"" << escape(error.what()) << "\"}";
+        return failed.str();
+    }
+    response << "}";
+    return response.str();
+}
+
+void Server::run (std::istream& input, std::ostream& output) {
+    std::string line;
+    while (std::getline(input, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        // flushed so that the other end gets every answer as soon as it's ready
+        output << answer(line) << std::endl;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <memory>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "times.hpp"
+#include "recording_reader.hpp"
+#include "probability_distribution.hpp"
+
+// long running mode that answers queries given as one JSON object per line, with one JSON object per line back
+// every distribution simulated is kept, so repeating a query (with any range, percentiles and so on) takes no simulations,
+// and the ones that weren't simulated yet are simulated in the background while other queries are answered
+class Server {
+public:
+    Server (RecordingReader& reader_value, int threads_value, std::int64_t simulations_value, std::uint64_t seed_value);
+
+    ~Server ();
+
+    // answer every line of `input` until it ends
+    void run (std::istream& input, std::ostream& output);
+
+private:
+    // what a distribution depends on, the rest of a query is read from the distribution
+    struct Config {
+        std::string run;
+        bool best;
+        bool tas;
+        int first_half_kills;
+        std::int64_t simulations;
+        std::uint64_t seed;
+        bool exact;
+        bool batched;
+
+        std::string get_key () const;
+    };
+
+    struct Entry {
+        bool ready;
+        // set if the simulation failed, like when a segment is missing
+        std::string error;
+        ProbabilityDistribution dist;
+
+        Entry ();
+    };
+
+    // a distribution waiting to be simulated, with its own copy of the times since the simulators keep a reference
+    struct Job {
+        Config config;
+        Times times;
+        std::shared_ptr<Entry> entry;
+    };
+
+    RecordingReader& reader;
+    int threads;
+    // defaults for the queries that don't give them
+    std::int64_t simulations;
+    std::uint64_t seed;
+
+    Times average;
+    Times best;
+
+    // the entries are only written by the worker while not ready, and only read by `run` once they are
+    std::map<std::string, std::shared_ptr<Entry>> entries;
+    std::deque<Job> jobs;
+    std::mutex mutex;
+    // signals both new jobs to the worker and finished ones to `run`
+    std::condition_variable changed;
+    bool stopping;
+    std::thread worker;
+
+    void work ();
+
+    std::string answer (const std::string& line);
+};
+
+#endif
\ No newline at end of file
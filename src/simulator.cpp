@@ -1,22 +1,679 @@
 #include <cmath>
+#include <vector>
+#include <stdexcept>
+#include <chrono>
+#include <algorithm>
+#include <array>
+#include <map>
+#include <unordered_map>
 #include "simulator.hpp"
+#include "column_writer.hpp"
+#include "random.hpp"
+#include "moments.hpp"
+#include "sobol.hpp"
 
-Simulator::Simulator (Times& times_value) : times(times_value) {}
+Simulator::Simulator (const Times& times_value) : times(times_value), execution(nullptr), dist_cache(nullptr) {}
+
+// a random stream for every worker, each one starting 2^128 draws after the previous one
+std::vector<Random> Simulator::make_streams (std::uint64_t seed, int threads) {
+    std::vector<Random> streams;
+    Random stream(seed);
+    for (int worker = 0; worker < threads; worker++) {
+        streams.push_back(stream);
+        stream.jump();
+    }
+    return streams;
+}
+
+// the first and past the last of `count` items taken by a worker, in order, with the first workers taking the remainder
+std::pair<std::int64_t, std::int64_t> Simulator::worker_range (std::int64_t count, int worker, int threads) {
+    std::int64_t first = worker * (count / threads) + std::min<std::int64_t>(worker, count % threads);
+    return { first, first + count / threads + (worker < count % threads ? 1 : 0) };
+}
+
+// simulate one run for every lane, simulators without a batched kernel run them one after the other
+void Simulator::simulate_batch (RandomLanes& lanes, int* results) {
+    SampleContext context;
+    for (int lane = 0; lane < RandomLanes::size; lane++) {
+        results[lane] = simulate(lanes.rng, context);
+    }
+}
 
 // run simulations and generate a probability distribution for the results
-ProbabilityDistribution Simulator::get_dist (int simulations) {
-    int* results = new int[simulations];
-    for (int i = 0; i < simulations; i++) {
-        results[i] = simulate();
+// the simulations are split between `threads` workers, each with its own copy of the simulator, its own random stream
+// and its own distribution, so the results only depend on the seed and the number of threads
+// the results are binned as they are produced, so any number of simulations can run without storing them
+// if `batched`, the simulations are run `RandomLanes::size` at a time with `simulate_batch`
+// with `execution`, the worker simulator reads the worker's own times, which are drawn again before every simulation
+// (the lanes of a batch would share them, so batching is skipped)
+ProbabilityDistribution Simulator::get_dist (std::int64_t simulations, int threads, std::uint64_t seed, bool batched) {
+    std::vector<ProbabilityDistribution> worker_dists(threads, ProbabilityDistribution(1));
+
+    std::vector<Random> streams = make_streams(seed, threads);
+
+    #pragma omp parallel for schedule(static, 1) num_threads(threads)
+    for (int worker = 0; worker < threads; worker++) {
+        auto [first, end] = worker_range(simulations, worker, threads);
+        std::int64_t worker_simulations = end - first;
+        Times worker_times = times;
+        Simulator* worker_simulator = clone(execution ? worker_times : times);
+        Random& rng = streams[worker];
+        SampleContext context;
+
+        ProbabilityDistribution& dist = worker_dists[worker];
+        std::int64_t i = 0;
+        if (batched && !execution) {
+            RandomLanes lanes(rng);
+            int results[RandomLanes::size];
+            for (; i + RandomLanes::size <= worker_simulations; i += RandomLanes::size) {
+                worker_simulator->simulate_batch(lanes, results);
+                for (int lane = 0; lane < RandomLanes::size; lane++) {
+                    dist.add_value(results[lane]);
+                }
+            }
+        }
+        for (; i < worker_simulations; i++) {
+            if (execution) execution->draw(rng, worker_times);
+            dist.add_value(worker_simulator->simulate(rng, context));
+        }
+        delete worker_simulator;
+    }
+
+    // merging in the worker order keeps the result reproducible
+    ProbabilityDistribution dist(1);
+    for (int worker = 0; worker < threads; worker++) {
+        dist.add(worker_dists[worker]);
+    }
+    return dist;
+}
+
+std::vector<std::string> Simulator::get_parts () {
+    return {};
+}
+
+// simulate one run, also giving the time and the random encounters of each part
+// without parts (see `get_parts`) there is nothing to give besides the time
+int Simulator::simulate_parts (Random& rng, SampleContext& context, int*, std::int64_t*) {
+    return simulate(rng, context);
+}
+
+// run simulations like `get_dist`, and write every one of them to `path` as the columns of a `ColumnWriter`:
+// the time, the random encounters, and both of them for every part
+// every worker writes its own rows, so the file is the same for the same seed and number of threads
+void Simulator::export_samples (const std::string& path, std::int64_t simulations, int threads, std::uint64_t seed) {
+    std::vector<std::string> parts = get_parts();
+    std::vector<std::string> names = { "time", "encounters" };
+    for (const std::string& part : parts) {
+        names.push_back(part + "-time");
+        names.push_back(part + "-encounters");
+    }
+    ColumnWriter writer(path, simulations, names);
+
+    std::vector<Random> streams = make_streams(seed, threads);
+
+    #pragma omp parallel for schedule(static, 1) num_threads(threads)
+    for (int worker = 0; worker < threads; worker++) {
+        auto [first_row, end] = worker_range(simulations, worker, threads);
+        std::int64_t worker_simulations = end - first_row;
+        Times worker_times = times;
+        Simulator* worker_simulator = clone(execution ? worker_times : times);
+        Random& rng = streams[worker];
+        SampleContext context;
+
+        std::vector<int> part_times(parts.size());
+        std::vector<std::int64_t> part_encounters(parts.size());
+        std::vector<std::int32_t> row(names.size());
+        ColumnBlock block(writer, names.size(), first_row);
+        for (std::int64_t i = 0; i < worker_simulations; i++) {
+            if (execution) execution->draw(rng, worker_times);
+            std::int64_t encounters = context.encounters;
+            row[0] = worker_simulator->simulate_parts(rng, context, part_times.data(), part_encounters.data());
+            row[1] = context.encounters - encounters;
+            for (std::size_t part = 0; part < parts.size(); part++) {
+                row[2 + 2 * part] = part_times[part];
+                row[3 + 2 * part] = part_encounters[part];
+            }
+            block.add(row.data());
+        }
+        block.flush();
+        delete worker_simulator;
+    }
+    writer.close();
+}
+
+// run simulations like `get_dist`, keeping what each one read from the times instead of its time (see `UsageModel`)
+// every worker groups its simulations into patterns on its own, and the patterns are then merged in the worker order
+UsageModel Simulator::get_usage_model (std::int64_t simulations, int threads, std::uint64_t seed) {
+    if (execution) throw std::runtime_error("usage models can't be made with drawn times");
+
+    // a worker's patterns, found by their area, their counts and their rooms
+    struct PatternHash {
+        std::size_t operator() (const std::vector<std::int32_t>& key) const {
+            std::uint64_t hash = 14695981039346656037ull;
+            for (std::int32_t value : key) {
+                hash = (hash ^ (std::uint32_t) value) * 1099511628211ull;
+            }
+            return hash;
+        }
+    };
+    struct WorkerModel {
+        std::unordered_map<std::vector<std::int32_t>, std::uint32_t, PatternHash> ids;
+        std::vector<std::vector<std::int32_t>> keys;
+        std::vector<std::uint32_t> sample_patterns;
+        std::vector<std::int32_t> random_frames;
+        // every room of the simulations, `SampleUsage::max_rooms` per simulation
+        std::vector<std::int16_t> room_steps;
+        int room_slots = 0;
+        bool too_many_rooms = false;
+    };
+    std::vector<WorkerModel> workers(threads);
+
+    // what each area reads, so the patterns of an area don't depend on the rest of the run
+    std::vector<std::vector<int>> area_indexes(Areas::Count);
+    for (int index = 0; index < usage_indexes; index++) {
+        area_indexes[UsageModel::get_area(index)].push_back(index);
     }
 
-    int size = sizeof(results) / sizeof(results[0]);
-    return ProbabilityDistribution (1, results, simulations);
+    std::vector<Random> streams = make_streams(seed, threads);
+
+    #pragma omp parallel for schedule(static, 1) num_threads(threads)
+    for (int worker = 0; worker < threads; worker++) {
+        auto [first, end] = worker_range(simulations, worker, threads);
+        std::int64_t worker_simulations = end - first;
+        Simulator* worker_simulator = clone(times);
+        Random& rng = streams[worker];
+        WorkerModel& model = workers[worker];
+        model.random_frames.reserve(worker_simulations);
+        model.sample_patterns.reserve(worker_simulations * Areas::Count);
+
+        SampleUsage usage;
+        SampleContext context;
+        context.usage = &usage;
+        std::vector<std::int32_t> key;
+        for (std::int64_t i = 0; i < worker_simulations; i++) {
+            usage.clear();
+            int time = worker_simulator->simulate(rng, context);
+            if (usage.room_count > SampleUsage::max_rooms) {
+                model.too_many_rooms = true;
+                break;
+            }
+
+            // what is left after taking out every read of the times is random
+            for (int segment = 0; segment < Segments::Count; segment++) {
+                time -= usage.counts[segment] * times.segments[segment];
+            }
+            for (int area = 0; area < Areas::Count; area++) {
+                time -= usage.counts[Segments::Count + area] * times.static_times[area];
+            }
+            for (int room = 0; room < usage.room_count; room++) {
+                time -= fix_step_total(usage.steps[room], usage.rooms[room]);
+            }
+
+            // the key of a pattern is its area, then its (index, uses), then -1 and its rooms
+            // the steps of the rooms are stored area after area, in the order of the patterns
+            for (int area = 0; area < Areas::Count; area++) {
+                key.assign(1, area);
+                for (int index : area_indexes[area]) {
+                    if (usage.counts[index] == 0) continue;
+                    key.push_back(index);
+                    key.push_back(usage.counts[index]);
+                }
+                key.push_back(-1);
+                for (int room = 0; room < usage.room_count; room++) {
+                    if (UsageModel::get_area(usage.rooms[room]) != area) continue;
+                    key.push_back(usage.rooms[room]);
+                    model.room_steps.push_back(usage.steps[room]);
+                }
+                auto id = model.ids.try_emplace(key, (std::uint32_t) model.keys.size());
+                if (id.second) model.keys.push_back(key);
+                model.sample_patterns.push_back(id.first->second);
+            }
+            model.room_steps.resize(model.room_steps.size() + SampleUsage::max_rooms - usage.room_count, 0);
+            model.room_slots = std::max(model.room_slots, usage.room_count);
+            model.random_frames.push_back(time);
+        }
+        delete worker_simulator;
+    }
+
+    UsageModel model;
+    for (const WorkerModel& worker : workers) {
+        if (worker.too_many_rooms) throw std::runtime_error("a simulation fixed the steps of too many rooms");
+        model.room_slots = std::max(model.room_slots, worker.room_slots);
+    }
+    std::map<std::vector<std::int32_t>, std::uint32_t> merged_ids;
+    for (const WorkerModel& worker : workers) {
+        // the ids of the worker's patterns in the model
+        std::vector<std::uint32_t> ids(worker.keys.size());
+        for (std::size_t id = 0; id < worker.keys.size(); id++) {
+            const std::vector<std::int32_t>& key = worker.keys[id];
+            auto merged = merged_ids.try_emplace(key, (std::uint32_t) model.patterns.size());
+            if (merged.second) {
+                UsageModel::Pattern pattern;
+                std::size_t pos = 1;
+                for (; key[pos] != -1; pos += 2) pattern.counts.push_back({ key[pos], key[pos + 1] });
+                pattern.rooms.assign(key.begin() + pos + 1, key.end());
+                model.patterns.push_back(pattern);
+            }
+            ids[id] = merged.first->second;
+        }
+        for (std::uint32_t id : worker.sample_patterns) {
+            model.sample_patterns.push_back(ids[id]);
+        }
+        model.random_frames.insert(model.random_frames.end(), worker.random_frames.begin(), worker.random_frames.end());
+        for (std::size_t sample = 0; sample < worker.random_frames.size(); sample++) {
+            const std::int16_t* steps = &worker.room_steps[sample * SampleUsage::max_rooms];
+            model.room_steps.insert(model.room_steps.end(), steps, steps + model.room_slots);
+        }
+    }
+    return model;
+}
+
+// `get_dist`, reading and storing the distribution in `dist_cache` if the simulator can be cached
+ProbabilityDistribution Simulator::get_cached_dist (std::int64_t simulations, int threads, std::uint64_t seed, bool batched) {
+    std::string key = get_cache_key();
+    // the drawn times aren't part of the key
+    if (!dist_cache || execution || key.empty()) return get_dist(simulations, threads, seed, batched);
+    return dist_cache->get(key, simulations, threads, seed, batched, [&] (std::int64_t count, std::uint64_t count_seed) {
+        return get_dist(count, threads, count_seed, batched);
+    });
+}
+
+// everything the results of the simulator depend on besides the options of `get_dist`, empty if it isn't cached
+std::string Simulator::get_cache_key () {
+    return "";
+}
+
+// key of a simulator that reads the times of a single area
+std::string Simulator::get_area_key (int area) {
+    return std::string(area_names[area]) + " " + std::to_string(times.area_hash(area));
+}
+
+// run simulations in rounds until `precise_enough` accepts the results or `seconds` have passed, whichever comes first
+// the rounds double the simulations so far, shrinking to what fits in the time left, so easy queries stop early
+// and only the hard ones (like chances far in the tails) run for long
+// every round gets its own seed from `seed`, but where a time limited run stops depends on the speed of the machine
+ProbabilityDistribution Simulator::get_dist_until (
+    const std::function<bool (ProbabilityDistribution&)>& precise_enough,
+    double seconds, int threads, std::uint64_t seed, bool batched
+) {
+    auto start = std::chrono::steady_clock::now();
+    Random round_seeds(seed);
+    ProbabilityDistribution dist(1);
+    std::int64_t round_simulations = 10'000;
+    while (true) {
+        dist.add(get_dist(round_simulations, threads, round_seeds.next(), batched));
+        if (precise_enough(dist)) break;
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (elapsed >= seconds) break;
+        double seconds_per_simulation = elapsed / dist.get_samples();
+        std::int64_t affordable = (std::int64_t) ((seconds - elapsed) / seconds_per_simulation);
+        round_simulations = std::max((std::int64_t) 1'000, std::min((std::int64_t) dist.get_samples(), affordable));
+    }
+    return dist;
+}
+
+// simulate every variant on the same random numbers (common random numbers), so that comparing them sample by sample
+// cancels most of the noise they share, and their differences need far fewer simulations than comparing separate runs
+// every sample draws a seed and each variant starts its own generator from it, so they stay on the same numbers
+// even when they use a different amount of them
+// the work is split between workers like in `get_dist`
+PairedDists Simulator::get_paired_dists (
+    const std::vector<Simulator*>& variants, const std::function<bool (int)>& in_range,
+    std::int64_t simulations, int threads, std::uint64_t seed
+) {
+    int variant_count = variants.size();
+    PairedDists empty = {
+        std::vector<ProbabilityDistribution>(variant_count, ProbabilityDistribution(1)),
+        std::vector<ProbabilityDistribution>(variant_count, ProbabilityDistribution(1)),
+        std::vector<ProbabilityDistribution>(variant_count, ProbabilityDistribution(1))
+    };
+    std::vector<PairedDists> worker_results(threads, empty);
+
+    std::vector<Random> streams = make_streams(seed, threads);
+
+    #pragma omp parallel for schedule(static, 1) num_threads(threads)
+    for (int worker = 0; worker < threads; worker++) {
+        auto [first, end] = worker_range(simulations, worker, threads);
+        std::int64_t worker_simulations = end - first;
+        std::vector<Simulator*> worker_variants;
+        for (Simulator* variant : variants) {
+            worker_variants.push_back(variant->clone(variant->times));
+        }
+
+        PairedDists& results = worker_results[worker];
+        std::vector<int> times(variant_count);
+        for (std::int64_t i = 0; i < worker_simulations; i++) {
+            std::uint64_t sample_seed = streams[worker].next();
+            for (int variant = 0; variant < variant_count; variant++) {
+                Random rng(sample_seed);
+                SampleContext context;
+                times[variant] = worker_variants[variant]->simulate(rng, context);
+                results.dists[variant].add_value(times[variant]);
+                results.time_differences[variant].add_value(times[variant] - times[0]);
+                results.chance_differences[variant].add_value(in_range(times[variant]) - in_range(times[0]));
+            }
+        }
+
+        for (Simulator* variant : worker_variants) {
+            delete variant;
+        }
+    }
+
+    PairedDists results = empty;
+    for (int worker = 0; worker < threads; worker++) {
+        for (int variant = 0; variant < variant_count; variant++) {
+            results.dists[variant].add(worker_results[worker].dists[variant]);
+            results.time_differences[variant].add(worker_results[worker].time_differences[variant]);
+            results.chance_differences[variant].add(worker_results[worker].chance_differences[variant]);
+        }
+    }
+    return results;
+}
+
+// order of the values measured for each simulation in `get_reduced_estimates`, followed by the `Controls`
+namespace Measured {
+    enum {
+        Time,
+        InRange,
+        Controls
+    };
+
+    // number of values measured
+    const int Count = int(Controls) + int(::Controls::Count);
+}
+
+// estimate the average of one of the measured values, taking out the part explained by the controls if `control_variates`
+// the controls average 0, so `value - coefficients * controls` has the same average as the value and, with the
+// coefficients from the least squares fit, the smallest variance
+// `sample_variance` is the variance of the value for a single plain simulation, out of `samples` simulations
+static Estimate estimate_measured (Moments& moments, int value, bool control_variates, double sample_variance, double samples) {
+    double average = moments.get_mean(value);
+    double variance = moments.get_covariance(value, value);
+
+    if (control_variates) {
+        // controls that never changed (like steps in a run without any) can't explain anything
+        std::vector<int> used;
+        for (int control = 0; control < Controls::Count; control++) {
+            if (moments.get_covariance(Measured::Controls + control, Measured::Controls + control) > 0) {
+                used.push_back(Measured::Controls + control);
+            }
+        }
+
+        // solving the normal equations (covariances of the controls * coefficients = covariances with the value)
+        int size = used.size();
+        std::vector<std::vector<double>> system(size, std::vector<double>(size + 1));
+        for (int i = 0; i < size; i++) {
+            for (int j = 0; j < size; j++) {
+                system[i][j] = moments.get_covariance(used[i], used[j]);
+            }
+            system[i][size] = moments.get_covariance(used[i], value);
+        }
+        for (int i = 0; i < size; i++) {
+            for (int j = i + 1; j < size; j++) {
+                double factor = system[j][i] / system[i][i];
+                for (int k = i; k <= size; k++) {
+                    system[j][k] -= factor * system[i][k];
+                }
+            }
+        }
+        std::vector<double> coefficients(size);
+        for (int i = size - 1; i >= 0; i--) {
+            double sum = system[i][size];
+            for (int j = i + 1; j < size; j++) {
+                sum -= system[i][j] * coefficients[j];
+            }
+            coefficients[i] = sum / system[i][i];
+        }
+
+        for (int i = 0; i < size; i++) {
+            average -= coefficients[i] * moments.get_mean(used[i]);
+            // what is left of the variance after removing the fitted part
+            variance -= coefficients[i] * moments.get_covariance(used[i], value);
+        }
+    }
+
+    double mean_variance = std::max(variance, 0.0) / moments.get_count();
+    double effective_samples = mean_variance > 0 ? sample_variance / mean_variance : samples;
+    return { average, 2.6 * std::sqrt(mean_variance), effective_samples };
+}
+
+// simulate with variance reduction, estimating the average and the chance of `in_range` more precisely than the plain
+// averages of the same number of simulations
+// with `antithetic`, the simulations come in pairs where the second one is the mirror of the first (every uniform `u`
+// becomes `1 - u`), so that a slow run is paired with a fast one and their noise partly cancels
+// with `control_variates`, the blcon and step totals of each simulation, whose averages are known, are used to correct
+// the estimates for how lucky the simulations were in them
+// every pair (or simulation) is measured as one unit, so the margins take the pairing into account
+ReducedEstimates Simulator::get_reduced_estimates (
+    const std::function<bool (int)>& in_range, std::int64_t simulations, int threads, std::uint64_t seed,
+    bool antithetic, bool control_variates
+) {
+    int copies = antithetic ? 2 : 1;
+    std::int64_t units = simulations / copies;
+    int measured = Measured::Count;
+    std::vector<ProbabilityDistribution> worker_dists(threads, ProbabilityDistribution(1));
+    std::vector<Moments> worker_moments(threads, Moments(measured));
+
+    std::vector<Random> streams = make_streams(seed, threads);
+
+    #pragma omp parallel for schedule(static, 1) num_threads(threads)
+    for (int worker = 0; worker < threads; worker++) {
+        auto [first, end] = worker_range(units, worker, threads);
+        std::int64_t worker_units = end - first;
+        Simulator* worker_simulator = clone(times);
+        double values[Moments::max_size];
+
+        for (std::int64_t i = 0; i < worker_units; i++) {
+            std::uint64_t unit_seed = streams[worker].next();
+            for (int value = 0; value < measured; value++) {
+                values[value] = 0;
+            }
+            for (int copy = 0; copy < copies; copy++) {
+                Random rng(unit_seed);
+                if (copy == 1) rng.mirror();
+                SampleContext context;
+                int time = worker_simulator->simulate(rng, context);
+                worker_dists[worker].add_value(time);
+
+                values[Measured::Time] += (double) time / copies;
+                values[Measured::InRange] += (double) in_range(time) / copies;
+                for (int control = 0; control < Controls::Count; control++) {
+                    values[Measured::Controls + control] += context.controls[control] / copies;
+                }
+            }
+            worker_moments[worker].add(values);
+        }
+        delete worker_simulator;
+    }
+
+    ProbabilityDistribution dist(1);
+    Moments moments(measured);
+    for (int worker = 0; worker < threads; worker++) {
+        dist.add(worker_dists[worker]);
+        moments.add(worker_moments[worker]);
+    }
+
+    double sample_variance = dist.get_stdev() * dist.get_stdev();
+    double chance = moments.get_mean(Measured::InRange);
+    return {
+        dist,
+        estimate_measured(moments, Measured::Time, control_variates, sample_variance, dist.get_samples()),
+        estimate_measured(moments, Measured::InRange, control_variates, chance * (1 - chance), dist.get_samples())
+    };
+}
+
+// how many standard errors make a 99% confidence interval for an average of `samples` independent values whose variance
+// is estimated from them (quantile of the t distribution, with the Cornish-Fisher expansion around the normal one)
+static double confidence_factor (int samples) {
+    const double z = 2.576;
+    double degrees = samples - 1;
+    return z + (z * z * z + z) / (4 * degrees)
+        + (5 * std::pow(z, 5) + 16 * z * z * z + 3 * z) / (96 * degrees * degrees);
+}
+
+// simulate with randomized quasi-Monte Carlo, estimating the average and the chance of `in_range` more precisely than
+// the plain averages of the same number of simulations when they depend smoothly on the random numbers
+// every simulation takes its draws from the coordinates of a point in a scrambled Sobol sequence, which cover all the
+// combinations of draws far more evenly than random ones, and the sequence is scrambled independently for every
+// replicate, so the spread of the replicate averages gives the margins
+ReducedEstimates Simulator::get_quasi_estimates (
+    const std::function<bool (int)>& in_range, std::int64_t simulations, int replicates, int threads, std::uint64_t seed
+) {
+    if (replicates < 2) throw std::runtime_error("At least 2 replicates are needed for the margins of error");
+    // the sequence is the most even in blocks of a power of two
+    std::int64_t points = 1;
+    while (points * replicates < simulations && points < (std::int64_t(1) << 32)) points *= 2;
+
+    std::vector<ProbabilityDistribution> replicate_dists(replicates, ProbabilityDistribution(1));
+    std::vector<std::array<double, 2>> replicate_values(replicates);
+    std::vector<std::uint64_t> scramble_seeds;
+    std::vector<std::uint64_t> stream_seeds;
+    Random seeds(seed);
+    for (int replicate = 0; replicate < replicates; replicate++) {
+        scramble_seeds.push_back(seeds.next());
+        stream_seeds.push_back(seeds.next());
+    }
+
+    #pragma omp parallel for schedule(static, 1) num_threads(threads)
+    for (int replicate = 0; replicate < replicates; replicate++) {
+        Simulator* replicate_simulator = clone(times);
+        std::vector<std::uint32_t> scrambles = Sobol::scrambles(scramble_seeds[replicate]);
+        // draws past the dimensions of the sequence are random
+        Random stream(stream_seeds[replicate]);
+        std::int64_t hits = 0;
+        for (std::int64_t i = 0; i < points; i++) {
+            QuasiPoint point = { (std::uint32_t) i, scrambles.data() };
+            QuasiRandom rng(stream.next(), &point);
+            SampleContext context;
+            int time = replicate_simulator->simulate(rng, context);
+            replicate_dists[replicate].add_value(time);
+            if (in_range(time)) hits++;
+        }
+        replicate_values[replicate] = { replicate_dists[replicate].get_average(), (double) hits / points };
+        delete replicate_simulator;
+    }
+
+    ProbabilityDistribution dist(1);
+    Moments moments(2);
+    for (int replicate = 0; replicate < replicates; replicate++) {
+        dist.add(replicate_dists[replicate]);
+        moments.add(replicate_values[replicate].data());
+    }
+
+    double factor = confidence_factor(replicates);
+    double sample_variances[] = { dist.get_stdev() * dist.get_stdev(), moments.get_mean(1) * (1 - moments.get_mean(1)) };
+    Estimate estimates[2];
+    for (int value = 0; value < 2; value++) {
+        double mean_variance = moments.get_covariance(value, value) / replicates;
+        double effective_samples = mean_variance > 0 ? sample_variances[value] / mean_variance : dist.get_samples();
+        estimates[value] = { moments.get_mean(value), factor * std::sqrt(mean_variance), effective_samples };
+    }
+    return { dist, estimates[0], estimates[1] };
+}
+
+// estimate the chance of `in_range` with importance sampling, for chances too small to get with plain simulations
+// the draws are taken from the chances of `proposal`, which make the range common, and each simulation counts with
+// its weight (see `Importance::draw`), which keeps the estimate unbiased
+Estimate Simulator::get_tail_estimate (
+    const std::function<bool (int)>& in_range, std::int64_t simulations, int threads, std::uint64_t seed,
+    const Proposal& proposal
+) {
+    std::vector<Moments> worker_moments(threads, Moments(1));
+
+    std::vector<Random> streams = make_streams(seed, threads);
+
+    #pragma omp parallel for schedule(static, 1) num_threads(threads)
+    for (int worker = 0; worker < threads; worker++) {
+        auto [first, end] = worker_range(simulations, worker, threads);
+        std::int64_t worker_simulations = end - first;
+        Simulator* worker_simulator = clone(times);
+        for (std::int64_t i = 0; i < worker_simulations; i++) {
+            DrawRecord record(&proposal);
+            Random rng(streams[worker].next());
+            SampleContext context;
+            context.record = &record;
+            int time = worker_simulator->simulate(rng, context);
+            double value = in_range(time) ? context.weight : 0;
+            worker_moments[worker].add(&value);
+        }
+        delete worker_simulator;
+    }
+
+    Moments moments(1);
+    for (int worker = 0; worker < threads; worker++) {
+        moments.add(worker_moments[worker]);
+    }
+
+    double chance = moments.get_mean(0);
+    double mean_variance = moments.get_covariance(0, 0) / moments.get_count();
+    double effective_samples = mean_variance > 0 ? chance * (1 - chance) / mean_variance : simulations;
+    return { chance, 2.6 * std::sqrt(mean_variance), effective_samples };
+}
+
+// find chances that make the times with a `distance` of 0 common, with the cross-entropy method
+// every round simulates with the current chances and fits them to what was drawn by the closest simulations, so each
+// round gets closer, until the closest ones are in the range
+Proposal Simulator::find_proposal (const std::function<double (int)>& distance, int threads, std::uint64_t seed) {
+    const std::int64_t round_simulations = 10'000;
+    const double closest_fraction = 0.1;
+    const int max_rounds = 20;
+
+    Proposal proposal;
+    Random round_seeds(seed);
+    for (int round = 0; round < max_rounds; round++) {
+        std::vector<DrawRecord> records(round_simulations, DrawRecord(&proposal));
+        std::vector<double> distances(round_simulations);
+        std::vector<double> weights(round_simulations);
+
+        std::vector<Random> streams = make_streams(round_seeds.next(), threads);
+
+        #pragma omp parallel for schedule(static, 1) num_threads(threads)
+        for (int worker = 0; worker < threads; worker++) {
+            Simulator* worker_simulator = clone(times);
+            for (std::int64_t i = worker; i < round_simulations; i += threads) {
+                Random rng(streams[worker].next());
+                SampleContext context;
+                context.record = &records[i];
+                distances[i] = distance(worker_simulator->simulate(rng, context));
+                weights[i] = context.weight;
+            }
+            delete worker_simulator;
+        }
+
+        // the closest simulations, which are all of the ones in the range if there are enough of them
+        std::vector<double> sorted = distances;
+        std::size_t level_pos = (std::size_t) (closest_fraction * round_simulations);
+        std::nth_element(sorted.begin(), sorted.begin() + level_pos, sorted.end());
+        double level = sorted[level_pos];
+        std::vector<const double*> closest_counts;
+        std::vector<double> closest_weights;
+        for (std::int64_t i = 0; i < round_simulations; i++) {
+            if (distances[i] <= level) {
+                closest_counts.push_back(&records[i].counts[0][0]);
+                closest_weights.push_back(weights[i]);
+            }
+        }
+        proposal.fit(closest_counts, closest_weights);
+        if (level == 0) break;
+    }
+    return proposal;
 }
 
 // uses a mathematical formula to calculate the marging of error from a calculated probability
-double Simulator::get_error_margin (int n, double probability) {
-    return 2.6 * std::sqrt((probability) * (1 - probability) / (double) n);
+// the probability is pulled slightly towards 1/2 (Agresti-Coull), so that a chance that no simulation hit yet
+// doesn't get a margin of 0
+double Simulator::get_error_margin (std::int64_t n, double probability) {
+    double adjusted_n = n + 4;
+    double adjusted = (probability * n + 2) / adjusted_n;
+    return 2.6 * std::sqrt(adjusted * (1 - adjusted) / adjusted_n);
+}
+
+// margin of error of the average of the simulations, with the same confidence (99%) as `get_error_margin`
+// exact distributions have no error
+double Simulator::get_average_error_margin (ProbabilityDistribution& dist) {
+    if (dist.get_samples() == 0) return 0;
+    return 2.6 * dist.get_stdev() / std::sqrt((double) dist.get_samples());
 }
 
 // this function is used when in a room where you must get somewhere, and the total
@@ -26,16 +683,45 @@ double Simulator::get_error_margin (int n, double probability) {
 // traverse the desired path, and the second element is basically the amount of time
 // that in the occasion the player stopped to grind in a place, it's how long it takes
 // to go from the place they were grinding to the next destination (usually the room transition)
-int Simulator::fix_step_total(int calculated_steps, std::string segment_name) {
+int Simulator::fix_step_total (int calculated_steps, int room) {
+    return fix_step_total(times, calculated_steps, room);
+}
+
+int Simulator::fix_step_total (const Times& times, int calculated_steps, int room) {
     // add 1 step because the methods for recording `downtime_steps` don't record the last frame
     // used to touch a door
     // TO-DO review how this applies to the dogi downtime-step
     int steps = calculated_steps + 1;
-    int* segments = times.steps[segment_name];
+    const std::array<int, 2>& segments = times.steps[room];
     // the + 1 turns the < into a <=
     // then this first case is where the step occurs before the end, so must AT LEAST traverse the whole path
     if (steps <= segments[0]) return segments[0];
     // in the other case, the total step required will then be the amount needed to grind the encounter
     // and then leave after grinding
     else return steps + segments[1];
+}
+
+// `fix_step_total`, keeping the room and the calculated steps in the usage of `context`
+int Simulator::fix_step_total (SampleContext& context, int calculated_steps, int room) {
+    SampleUsage* usage = context.usage;
+    if (usage && usage->room_count < SampleUsage::max_rooms) {
+        usage->rooms[usage->room_count] = room;
+        usage->steps[usage->room_count] = calculated_steps;
+    }
+    if (usage) usage->room_count++;
+    return fix_step_total(calculated_steps, room);
+}
+
+// distribution of `fix_step_total` for the chances of the calculated steps
+ProbabilityDistribution Simulator::fix_step_chances (const Chances& steps, int room) {
+    ProbabilityDistribution fixed(1);
+    for (const auto& step : steps) {
+        fixed.add_weight(fix_step_total(step.first, room), step.second);
+    }
+    return fixed;
+}
+
+// calculate the exact distribution of `simulate` instead of sampling it, for the simulators that support it
+ProbabilityDistribution Simulator::get_exact_dist () {
+    throw std::runtime_error("this run has no exact distribution");
 }
\ No newline at end of file
@@ -2,23 +2,149 @@
 #define SIMULATOR_H
 
 #include <string>
+#include <map>
+#include <vector>
+#include <functional>
 #include "times.hpp"
 #include "probability_distribution.hpp"
+#include "random.hpp"
+#include "sobol.hpp"
+#include "sample_context.hpp"
+#include "importance.hpp"
+#include "execution_times.hpp"
+#include "dist_cache.hpp"
+#include "usage_model.hpp"
+
+// results of simulating several variants of a route on the same random numbers
+struct PairedDists {
+    // distribution of the times of each variant
+    std::vector<ProbabilityDistribution> dists;
+    // distribution of the difference to the first variant in the time, and in being in the range of the chance (-1, 0 or 1),
+    // sample by sample
+    std::vector<ProbabilityDistribution> time_differences;
+    std::vector<ProbabilityDistribution> chance_differences;
+};
+
+// estimate of a value with its margin of error (99% confidence),
+// and how many plain simulations it would have taken to get the same margin
+struct Estimate {
+    double value;
+    double margin;
+    double effective_samples;
+};
+
+// results of simulating with variance reduction
+struct ReducedEstimates {
+    // distribution of all the simulated times
+    ProbabilityDistribution dist;
+    Estimate average;
+    // chance of being in the range given
+    Estimate chance;
+};
 
 // handles methods for generating simulations and gathering its results
 class Simulator {
 public:
-    Times& times;
+    const Times& times;
+
+    // if set, every simulation of `get_dist` draws its own times from the recordings instead of using `times`
+    const ExecutionTimes* execution;
+
+    // if set, `get_cached_dist` keeps the distributions there
+    DistCache* dist_cache;
+
+    // one simulation, with random or quasi-random draws, keeping what the modes need in `context`
+    virtual int simulate (Random& rng, SampleContext& context) = 0;
 
-    virtual int simulate() = 0;
+    virtual int simulate (QuasiRandom& rng, SampleContext& context) = 0;
 
-    int fix_step_total (int calculated_steps, std::string segment_name);
+    virtual void simulate_batch (RandomLanes& lanes, int* results);
+
+    // parts the time of a simulation is split into for `export_samples`, none for simulators of a single area
+    virtual std::vector<std::string> get_parts ();
+
+    virtual int simulate_parts (Random& rng, SampleContext& context, int* part_times, std::int64_t* part_encounters);
+
+    // create a copy of the simulator that reads from other times, so each thread can own one
+    virtual Simulator* clone (const Times& times_value) = 0;
+
+    virtual ~Simulator () {}
+
+    int fix_step_total (int calculated_steps, int room);
+
+    static int fix_step_total (const Times& times, int calculated_steps, int room);
+
+    ProbabilityDistribution fix_step_chances (const Chances& steps, int room);
+
+    virtual ProbabilityDistribution get_exact_dist ();
     
-    Simulator (Times& times_value);
+    Simulator (const Times& times_value);
+
+    static std::vector<Random> make_streams (std::uint64_t seed, int threads);
+
+    static std::pair<std::int64_t, std::int64_t> worker_range (std::int64_t count, int worker, int threads);
+
+    virtual ProbabilityDistribution get_dist (std::int64_t simulations, int threads, std::uint64_t seed, bool batched);
+
+    void export_samples (const std::string& path, std::int64_t simulations, int threads, std::uint64_t seed);
+
+    UsageModel get_usage_model (std::int64_t simulations, int threads, std::uint64_t seed);
+
+    ProbabilityDistribution get_cached_dist (std::int64_t simulations, int threads, std::uint64_t seed, bool batched);
+
+    virtual std::string get_cache_key ();
+
+    ProbabilityDistribution get_dist_until (
+        const std::function<bool (ProbabilityDistribution&)>& precise_enough,
+        double seconds, int threads, std::uint64_t seed, bool batched
+    );
+
+    static PairedDists get_paired_dists (
+        const std::vector<Simulator*>& variants, const std::function<bool (int)>& in_range,
+        std::int64_t simulations, int threads, std::uint64_t seed
+    );
+
+    ReducedEstimates get_reduced_estimates (
+        const std::function<bool (int)>& in_range, std::int64_t simulations, int threads, std::uint64_t seed,
+        bool antithetic, bool control_variates
+    );
+
+    ReducedEstimates get_quasi_estimates (
+        const std::function<bool (int)>& in_range, std::int64_t simulations, int replicates, int threads, std::uint64_t seed
+    );
+
+    Estimate get_tail_estimate (
+        const std::function<bool (int)>& in_range, std::int64_t simulations, int threads, std::uint64_t seed,
+        const Proposal& proposal
+    );
+
+    Proposal find_proposal (const std::function<double (int)>& distance, int threads, std::uint64_t seed);
+
+    double get_error_margin (std::int64_t n, double probability);
+
+    double get_average_error_margin (ProbabilityDistribution& dist);
+
+protected:
+    std::string get_area_key (int area);
+
+    // the reads of the times in `simulate`, which count what was read when `context` has a usage
+    int use_segment (SampleContext& context, int segment, int uses = 1) {
+        if (context.usage) context.usage->counts[segment] += uses;
+        return uses * times.segments[segment];
+    }
+
+    int use_static_time (SampleContext& context, int area) {
+        if (context.usage) context.usage->counts[Segments::Count + area]++;
+        return times.static_times[area];
+    }
 
-    ProbabilityDistribution get_dist (int simulations);
+    int fix_step_total (SampleContext& context, int calculated_steps, int room);
 
-    double get_error_margin (int n, double probability);
+    // add a branch of an exact distribution to the state it ends in
+    template <typename State>
+    static void add_state (std::map<State, ProbabilityDistribution>& states, State state, const ProbabilityDistribution& dist) {
+        states.try_emplace(state, 1).first->second.add(dist);
+    }
 };
 
 #endif
\ No newline at end of file
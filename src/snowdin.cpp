@@ -2,54 +2,125 @@
 #include "undertale.hpp"
 #include "encounters.hpp"
 
-Snowdin::Snowdin (Times& times_value) : Simulator(times_value) {}
+Snowdin::Snowdin (const Times& times_value) : Simulator(times_value) {
+    times.require(Areas::Snowdin);
+}
 
-int Snowdin::simulate () {
-    int time = times.segments["snowdin"];
-    time += Undertale::encounter_time_random(times.static_blcons["snowdin"]);
+Simulator* Snowdin::clone (const Times& times_value) {
+    return new Snowdin(times_value);
+}
+
+std::string Snowdin::get_cache_key () {
+    return get_area_key(Areas::Snowdin);
+}
+
+template <typename Rng>
+int Snowdin::simulate_draws (Rng& rng, SampleContext& context) {
+    int time = use_static_time(context, Areas::Snowdin);
+    time += Undertale::encounter_time_random(rng, context, times.static_blcons[Areas::Snowdin]);
     int kills = 0;
 
     // single snowdrake steps
-    time += fix_step_total(Undertale::snowdin_general_steps(kills), "snowdin-box-road");
+    time += fix_step_total(context, Undertale::snowdin_general_steps(rng, context, kills), Segments::SnowdinBoxRoad);
 
     kills = 3;
     while (kills < 16) {
-        int encounter = Undertale::snowdin();
+        int encounter = Undertale::snowdin(rng, context);
         bool fight_jerry =
-            encounter == Encounters::SnowdinDouble && kills == 14 ||
-            encounter == Encounters::SnowdinTriple && kills == 13;
+            (encounter == Encounters::SnowdinDouble && kills == 14) ||
+            (encounter == Encounters::SnowdinTriple && kills == 13);
         
         if (kills == 3) {
             // dogi bridge (steps + encounter)
-            time += fix_step_total(Undertale::dogi_room_steps(kills), "snowdin-dogi");
+            time += fix_step_total(context, Undertale::dogi_room_steps(rng, context, kills), Segments::SnowdinDogi);
         } else {
-            time += Undertale::snowdin_general_steps(kills);
-            time += Undertale::encounter_time_random();
+            time += Undertale::snowdin_general_steps(rng, context, kills);
+            time += Undertale::encounter_time_random(rng, context);
 
-            if (kills < 10 || kills == 13 && encounter == Encounters::SnowdinDouble) {
-                time += times.segments["snowdin-right-transition"];
+            if (kills < 10 || (kills == 13 && encounter == Encounters::SnowdinDouble)) {
+                time += use_segment(context, Segments::SnowdinRightTransition);
             } else if (kills < 13) {
-                time += times.segments["snowdin-left-transition"];
+                time += use_segment(context, Segments::SnowdinLeftTransition);
             }
         }
 
         if (encounter == Encounters::SnowdinDouble) {
             if (fight_jerry) {
-                time += times.segments["snowdin-dbl-jerry"];
+                time += use_segment(context, Segments::SnowdinDblJerry);
                 kills += 2;
             } else {
-                time += times.segments["snowdin-dbl"];
+                time += use_segment(context, Segments::SnowdinDbl);
                 kills++;
             }
         } else if (encounter == Encounters::SnowdinTriple) {
             if (fight_jerry) {
-                time += times.segments["snowdin-tpl-jerry"];
+                time += use_segment(context, Segments::SnowdinTplJerry);
                 kills += 3;
             } else {
-                time += times.segments["snowdin-tpl"];
+                time += use_segment(context, Segments::SnowdinTpl);
                 kills += 2;
             }
         }
     }
     return time;
+}
+
+int Snowdin::simulate (Random& rng, SampleContext& context) {
+    return simulate_draws(rng, context);
+}
+
+int Snowdin::simulate (QuasiRandom& rng, SampleContext& context) {
+    return simulate_draws(rng, context);
+}
+
+// same as `simulate`, but following every branch with its chance to get the exact distribution, tracking the kills
+ProbabilityDistribution Snowdin::get_exact_dist () {
+    ProbabilityDistribution time = Undertale::encounter_time_chances(times.static_blcons[Areas::Snowdin]);
+    time.shift(times.static_times[Areas::Snowdin]);
+
+    // single snowdrake steps
+    time.convolve(fix_step_chances(Undertale::snowdin_general_steps_chances(0), Segments::SnowdinBoxRoad));
+
+    std::map<int, ProbabilityDistribution> states;
+    states.emplace(3, time);
+    ProbabilityDistribution result(1);
+    for (const auto& [kills, dist] : states) {
+        if (kills >= 16) {
+            result.add(dist);
+            continue;
+        }
+
+        for (const auto& encounter : Undertale::snowdin_chances()) {
+            bool fight_jerry =
+                (encounter.first == Encounters::SnowdinDouble && kills == 14) ||
+                (encounter.first == Encounters::SnowdinTriple && kills == 13);
+
+            ProbabilityDistribution branch = dist;
+            if (kills == 3) {
+                // dogi bridge (steps + encounter)
+                branch.convolve(fix_step_chances(Undertale::dogi_room_steps_chances(kills), Segments::SnowdinDogi));
+            } else {
+                branch.convolve(ProbabilityDistribution(Undertale::snowdin_general_steps_chances(kills)));
+                branch.convolve(Undertale::encounter_time_chances(1));
+
+                if (kills < 10 || (kills == 13 && encounter.first == Encounters::SnowdinDouble)) {
+                    branch.shift(times.segments[Segments::SnowdinRightTransition]);
+                } else if (kills < 13) {
+                    branch.shift(times.segments[Segments::SnowdinLeftTransition]);
+                }
+            }
+
+            int encounter_kills;
+            if (encounter.first == Encounters::SnowdinDouble) {
+                branch.shift(fight_jerry ? times.segments[Segments::SnowdinDblJerry] : times.segments[Segments::SnowdinDbl]);
+                encounter_kills = fight_jerry ? 2 : 1;
+            } else {
+                branch.shift(fight_jerry ? times.segments[Segments::SnowdinTplJerry] : times.segments[Segments::SnowdinTpl]);
+                encounter_kills = fight_jerry ? 3 : 2;
+            }
+            branch.scale(encounter.second);
+            add_state(states, kills + encounter_kills, branch);
+        }
+    }
+    return result;
 }
\ No newline at end of file
@@ -7,9 +7,21 @@
 class Snowdin : public Simulator {
 
 public:
-    Snowdin (Times& times_value);
+    Snowdin (const Times& times_value);
 
-    int simulate() override;
+    int simulate (Random& rng, SampleContext& context) override;
+
+    int simulate (QuasiRandom& rng, SampleContext& context) override;
+
+    ProbabilityDistribution get_exact_dist () override;
+
+    Simulator* clone (const Times& times_value) override;
+
+    std::string get_cache_key () override;
+
+private:
+    template <typename Rng>
+    int simulate_draws (Rng& rng, SampleContext& context);
 };
 
 #endif
\ No newline at end of file
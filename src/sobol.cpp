@@ -0,0 +1,162 @@
+#include <array>
+#include "sobol.hpp"
+
+// degree of a polynomial over GF(2), stored as the bits of its coefficients
+static int degree (std::uint32_t polynomial) {
+    int result = -1;
+    for (; polynomial; polynomial >>= 1) result++;
+    return result;
+}
+
+// x^power modulo `polynomial`, over GF(2)
+static std::uint32_t power_of_x (std::uint64_t power, std::uint32_t polynomial) {
+    int polynomial_degree = degree(polynomial);
+    std::uint32_t result = 1;
+    std::uint32_t base = 2;
+    // multiplication modulo the polynomial
+    auto multiply = [&] (std::uint32_t a, std::uint32_t b) {
+        std::uint32_t product = 0;
+        for (; b; b >>= 1) {
+            if (b & 1) product ^= a;
+            a <<= 1;
+            if (a >> polynomial_degree & 1) a ^= polynomial;
+        }
+        return product;
+    };
+    for (; power; power >>= 1) {
+        if (power & 1) result = multiply(result, base);
+        base = multiply(base, base);
+    }
+    return result;
+}
+
+// a polynomial is primitive when x has the largest order possible, 2^degree - 1
+static bool is_primitive (std::uint32_t polynomial) {
+    std::uint64_t order = (std::uint64_t(1) << degree(polynomial)) - 1;
+    if (power_of_x(order, polynomial) != 1) return false;
+    std::uint64_t rest = order;
+    for (std::uint64_t factor = 2; factor <= rest; factor++) {
+        if (rest % factor != 0) continue;
+        if (power_of_x(order / factor, polynomial) == 1) return false;
+        while (rest % factor == 0) rest /= factor;
+    }
+    return true;
+}
+
+// direction numbers of every dimension, made once
+// the first dimension is the van der Corput sequence, and the others use the primitive polynomials in order of degree,
+// with fixed pseudo-random odd initial numbers since the scrambling takes care of most of the quality
+static const std::vector<std::array<std::uint32_t, 32>>& directions () {
+    static const std::vector<std::array<std::uint32_t, 32>> table = [] {
+        std::vector<std::array<std::uint32_t, 32>> table(Sobol::dimensions);
+        for (int bit = 0; bit < 32; bit++) {
+            table[0][bit] = std::uint32_t(1) << (31 - bit);
+        }
+
+        Random initial_numbers(0x50b01);
+        std::uint32_t polynomial = 3;
+        for (int dimension = 1; dimension < Sobol::dimensions; dimension++) {
+            while (!is_primitive(polynomial)) polynomial++;
+            int s = degree(polynomial);
+
+            // odd and under 2^k, which leaves m_1 = 1 and k - 1 random bits for the others
+            std::array<std::uint32_t, 32> m;
+            m[0] = 1;
+            for (int k = 2; k <= s; k++) {
+                m[k - 1] = (initial_numbers.next() >> (64 - (k - 1))) << 1 | 1;
+            }
+            for (int k = s + 1; k <= 32; k++) {
+                std::uint32_t value = m[k - s - 1] ^ (m[k - s - 1] << s);
+                for (int i = 1; i < s; i++) {
+                    if (polynomial >> (s - i) & 1) value ^= m[k - i - 1] << i;
+                }
+                m[k - 1] = value;
+            }
+            for (int k = 1; k <= 32; k++) {
+                table[dimension][k - 1] = m[k - 1] << (32 - k);
+            }
+            polynomial++;
+        }
+        return table;
+    }();
+    return table;
+}
+
+static std::uint32_t reverse_bits (std::uint32_t x) {
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ff) << 8) | ((x & 0xff00ff00) >> 8);
+    x = ((x & 0x0f0f0f0f) << 4) | ((x & 0xf0f0f0f0) >> 4);
+    x = ((x & 0x33333333) << 2) | ((x & 0xcccccccc) >> 2);
+    x = ((x & 0x55555555) << 1) | ((x & 0xaaaaaaaa) >> 1);
+    return x;
+}
+
+// coordinate of a point with Owen scrambling, as 32 bits of a number in [0, 1)
+// the scrambling flips every digit depending on the digits before it, which keeps the sequence evenly spread
+// while making every point uniformly random, so independently scrambled copies give unbiased estimates
+// (hash-based nested uniform scrambling, Burley 2020)
+std::uint32_t Sobol::coordinate (std::uint32_t index, int dimension, std::uint32_t scramble) {
+    const std::array<std::uint32_t, 32>& direction = directions()[dimension];
+    std::uint32_t x = 0;
+    for (; index; index &= index - 1) {
+        x ^= direction[__builtin_ctz(index)];
+    }
+
+    x = reverse_bits(x);
+    x += scramble;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return reverse_bits(x);
+}
+
+// independent scrambling seeds for every dimension
+std::vector<std::uint32_t> Sobol::scrambles (std::uint64_t seed) {
+    Random rng(seed);
+    std::vector<std::uint32_t> result(dimensions);
+    for (std::uint32_t& scramble : result) {
+        scramble = rng.next() >> 32;
+    }
+    return result;
+}
+
+// every dimension of the sequence is handed out, from the first one
+QuasiRandom::QuasiRandom (std::uint64_t seed, const QuasiPoint* point_value) :
+    random(seed), point(point_value), dimension(0), dimension_end(Sobol::dimensions) {}
+
+std::uint64_t QuasiRandom::next () {
+    std::uint64_t result = random.next();
+    // the low half stays random so that the draws are still continuous past the 32 bits of the coordinate
+    if (dimension < dimension_end) {
+        std::uint32_t coordinate = Sobol::coordinate(point->index, dimension, point->scrambles[dimension]);
+        dimension++;
+        result = (std::uint64_t(coordinate) << 32) | (result >> 32);
+    }
+    return result;
+}
+
+// create a generator seeded from this one for the same point, which takes the second half of the dimensions left,
+// so the draws of both always keep the same dimensions
+QuasiRandom QuasiRandom::split () {
+    QuasiRandom child(next(), point);
+    child.dimension = dimension + (dimension_end - dimension) / 2;
+    child.dimension_end = dimension_end;
+    dimension_end = child.dimension;
+    return child;
+}
+
+// take the next coordinates from the dimensions `first` to `end` (not included), so that a part of the
+// simulation uses the same dimensions no matter how many draws came before it
+void QuasiRandom::use_dimensions (int first, int end) {
+    dimension = first;
+    dimension_end = end;
+}
+
+double QuasiRandom::random_number () {
+    return (double)(next() >> 11) * 0x1.0p-53;
+}
+
+bool QuasiRandom::chance (std::uint64_t threshold) {
+    return next() < threshold;
+}
\ No newline at end of file
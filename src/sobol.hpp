@@ -0,0 +1,49 @@
+#ifndef SOBOL_H
+#define SOBOL_H
+
+#include <cstdint>
+#include <vector>
+#include "random.hpp"
+
+// scrambled Sobol sequence, a low-discrepancy sequence whose points cover [0, 1)^d far more evenly than random points
+class Sobol {
+public:
+    // dimensions with a direction table, draws past them fall back to the random stream
+    static const int dimensions = 1024;
+
+    static std::uint32_t coordinate (std::uint32_t index, int dimension, std::uint32_t scramble);
+
+    static std::vector<std::uint32_t> scrambles (std::uint64_t seed);
+};
+
+// the point of a simulation in a scrambled Sobol sequence, whose coordinates are handed to its draws
+// (see `QuasiRandom::use_dimensions`)
+struct QuasiPoint {
+    std::uint32_t index;
+    // seed of the scrambling of each dimension
+    const std::uint32_t* scrambles;
+};
+
+// draws of a quasi-Monte Carlo simulation, with the same methods as `Random` for the simulators
+// the top half of every draw is the coordinate of `point` in the next dimension, from `dimension` up to `dimension_end`,
+// and the draws past them come from the random stream
+class QuasiRandom {
+    Random random;
+    const QuasiPoint* point;
+    int dimension;
+    int dimension_end;
+public:
+    QuasiRandom (std::uint64_t seed, const QuasiPoint* point_value);
+
+    std::uint64_t next ();
+
+    QuasiRandom split ();
+
+    void use_dimensions (int first, int end);
+
+    double random_number ();
+
+    bool chance (std::uint64_t threshold);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,231 @@
+#ifndef STRUCTURE_TABLES_H
+#define STRUCTURE_TABLES_H
+
+#include <array>
+#include <string_view>
+#include "time_structure.xml"
+
+// the time structure turned into flat tables while compiling, so that building `Times` is a pass over them
+// the XML is read the same way the old tree walkers did: statics, deltas, blcons, steps and numbered loops directly
+// inside an area add to it, and the named deltas of the defs define new segments
+namespace Structure {
+    static const int max_elements = 1024;
+    static const int max_depth = 32;
+    static const int max_operations = 256;
+    static const int max_rooms = 32;
+    static const int max_areas = 8;
+
+    // an element of the XML, with its children linked as a list
+    struct Element {
+        std::string_view name;
+        // value of its first attribute and its own text, empty if it has none
+        std::string_view attribute;
+        std::string_view text;
+        int first_child;
+        int next_sibling;
+    };
+
+    struct Document {
+        std::array<Element, max_elements> elements;
+        int count;
+    };
+
+    constexpr bool is_space (char c) {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    constexpr std::string_view trim (std::string_view text) {
+        while (!text.empty() && is_space(text.front())) text.remove_prefix(1);
+        while (!text.empty() && is_space(text.back())) text.remove_suffix(1);
+        return text;
+    }
+
+    // the subset of XML the structure uses: elements, one attribute, text and comments
+    // anything the reader can't handle stops the compilation (throwing isn't allowed in a constant expression)
+    constexpr Document parse (std::string_view xml) {
+        Document document {};
+        document.count = 0;
+        // open elements and the last child of each, -1 for the document itself
+        int open[max_depth + 1] = { -1 };
+        int last_child[max_depth + 1] = { -1 };
+        int depth = 0;
+
+        std::size_t pos = 0;
+        while (pos < xml.size()) {
+            if (xml.substr(pos, 4) == "<!--") {
+                pos = xml.find("-->", pos) + 3;
+            } else if (xml[pos] == '<' && xml[pos + 1] == '/') {
+                pos = xml.find('>', pos) + 1;
+                depth--;
+                if (depth < 0) throw "closing tag without an element";
+            } else if (xml[pos] == '<') {
+                std::size_t tag_end = xml.find('>', pos);
+                std::size_t name_end = pos + 1;
+                while (name_end < tag_end && !is_space(xml[name_end]) && xml[name_end] != '/') name_end++;
+                if (document.count == max_elements) throw "too many elements";
+                int index = document.count++;
+                Element& element = document.elements[index];
+                element.name = xml.substr(pos + 1, name_end - pos - 1);
+                element.first_child = -1;
+                element.next_sibling = -1;
+                std::size_t quote = xml.find('"', name_end);
+                if (quote < tag_end) {
+                    element.attribute = xml.substr(quote + 1, xml.find('"', quote + 1) - quote - 1);
+                }
+
+                if (last_child[depth] != -1) document.elements[last_child[depth]].next_sibling = index;
+                else if (open[depth] != -1) document.elements[open[depth]].first_child = index;
+                last_child[depth] = index;
+
+                if (xml[tag_end - 1] != '/') {
+                    depth++;
+                    if (depth > max_depth) throw "elements nested too deep";
+                    open[depth] = index;
+                    last_child[depth] = -1;
+                }
+                pos = tag_end + 1;
+            } else {
+                std::size_t text_end = xml.find('<', pos);
+                if (text_end == std::string_view::npos) text_end = xml.size();
+                std::string_view text = trim(xml.substr(pos, text_end - pos));
+                if (!text.empty() && depth > 0 && document.elements[open[depth]].text.empty()) {
+                    document.elements[open[depth]].text = text;
+                }
+                pos = text_end;
+            }
+        }
+        if (depth != 0) throw "element not closed";
+        return document;
+    }
+
+    // first text inside an element, searching its children in order
+    constexpr std::string_view first_text (const Document& document, int index) {
+        const Element& element = document.elements[index];
+        if (!element.text.empty()) return element.text;
+        for (int child = element.first_child; child != -1; child = document.elements[child].next_sibling) {
+            std::string_view text = first_text(document, child);
+            if (!text.empty()) return text;
+        }
+        return {};
+    }
+
+    constexpr int to_int (std::string_view text) {
+        int value = 0;
+        for (char c : text) {
+            if (c < '0' || c > '9') throw "loop count is not a number";
+            value = value * 10 + (c - '0');
+        }
+        return value;
+    }
+
+    // a step of building the times: `value[target] += factor * value[source]`, or clearing the target without a source
+    struct Operation {
+        std::string_view target;
+        std::string_view source;
+        int factor;
+    };
+
+    struct Tables {
+        // in the order they must be applied
+        std::array<Operation, max_operations> operations;
+        int operation_count;
+        // rooms whose steps come from their `-steps` and `-endsteps` segments
+        std::array<std::string_view, max_rooms> rooms;
+        int room_count;
+        // areas with the number of blcons that always happen in them
+        std::array<std::string_view, max_areas> areas;
+        std::array<int, max_areas> blcons;
+        int area_count;
+
+        constexpr void add (std::string_view target, std::string_view source, int factor) {
+            if (operation_count == max_operations) throw "too many operations";
+            operations[operation_count++] = { target, source, factor };
+        }
+    };
+
+    // the terms of a delta (every `pos` and `neg` inside it, at any depth) as operations on `target`
+    constexpr void add_delta (const Document& document, int delta, std::string_view target, Tables& tables) {
+        // depth first through the descendants, with the elements left to visit in a stack
+        int stack[max_elements] = {};
+        int size = 0;
+        for (int child = document.elements[delta].first_child; child != -1; child = document.elements[child].next_sibling) {
+            stack[size++] = child;
+        }
+        while (size > 0) {
+            int index = stack[--size];
+            const Element& element = document.elements[index];
+            if (element.name == "pos") tables.add(target, first_text(document, index), 1);
+            if (element.name == "neg") tables.add(target, first_text(document, index), -1);
+            for (int child = element.first_child; child != -1; child = document.elements[child].next_sibling) {
+                stack[size++] = child;
+            }
+        }
+    }
+
+    // name given to a delta, empty if it has none
+    constexpr std::string_view delta_name (const Document& document, int delta) {
+        for (int child = document.elements[delta].first_child; child != -1; child = document.elements[child].next_sibling) {
+            if (document.elements[child].name == "name") return first_text(document, child);
+        }
+        return {};
+    }
+
+    constexpr Tables compile (const Document& document) {
+        Tables tables {};
+        const auto& elements = document.elements;
+        // the root is `segments`, and its children the areas
+        for (int area = elements[0].first_child; area != -1; area = elements[area].next_sibling) {
+            if (tables.area_count == max_areas) throw "too many areas";
+            std::string_view area_name = elements[area].attribute;
+            int& blcons = tables.blcons[tables.area_count];
+            tables.areas[tables.area_count++] = area_name;
+            tables.add(area_name, {}, 0);
+
+            std::string_view last_static;
+            for (int node = elements[area].first_child; node != -1; node = elements[node].next_sibling) {
+                std::string_view name = elements[node].name;
+                if (name == "static") {
+                    last_static = first_text(document, node);
+                    tables.add(area_name, last_static, 1);
+                } else if (name == "variant") {
+                    std::string_view variant = first_text(document, node);
+                    if (variant == "steps*") {
+                        if (tables.room_count == max_rooms) throw "too many rooms with steps";
+                        tables.rooms[tables.room_count++] = last_static;
+                    } else if (variant == "blcon") {
+                        blcons++;
+                    }
+                } else if (name == "delta") {
+                    add_delta(document, node, area_name, tables);
+                } else if (name == "loop" && elements[node].attribute != "?") {
+                    int times = to_int(elements[node].attribute);
+                    for (int child = elements[node].first_child; child != -1; child = elements[child].next_sibling) {
+                        std::string_view variant = first_text(document, child);
+                        if (elements[child].name == "static") tables.add(area_name, variant, times);
+                        else if (elements[child].name == "variant" && variant == "blcon") blcons += times;
+                    }
+                } else if (name == "def") {
+                    // deltas in the options of a def give the value of a new segment
+                    for (int option = elements[node].first_child; option != -1; option = elements[option].next_sibling) {
+                        for (int child = elements[option].first_child; child != -1; child = elements[child].next_sibling) {
+                            if (elements[child].name != "delta") continue;
+                            std::string_view target = delta_name(document, child);
+                            // the terms are added after clearing the target, so they can't read it
+                            tables.add(target, {}, 0);
+                            int first = tables.operation_count;
+                            add_delta(document, child, target, tables);
+                            for (int i = first; i < tables.operation_count; i++) {
+                                if (tables.operations[i].source == target) throw "a delta can't use its own segment";
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return tables;
+    }
+
+    constexpr Tables tables = compile(parse(time_structure));
+}
+
+#endif
\ No newline at end of file
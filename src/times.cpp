@@ -1,116 +1,147 @@
 #include <iostream>
-#include "thirdparty/pugixml.hpp"
-#include "time_structure.xml"
+#include <stdexcept>
+#include <vector>
+#include <string_view>
+#include "structure_tables.hpp"
 #include "times.hpp"
 
-Times::Times () {}
+Times::Times () : segments{}, steps{}, static_times{}, static_blcons{}, recorded{} {}
 
-bool Times::value_walker::for_each (pugi::xml_node& node) {
-    std::string name = node.name();
-    if (name == "") {
-        found_value = node.value();
-        return false;
-    }
-    
-    return true;
-}
+namespace {
+    // the tables of `structure_tables.hpp` with every name replaced by an index into the values of a `Times`
+    // the names are the ones in the structure and the segments, built once the first time it's needed
+    struct Layout {
+        static const int max_names = 1024;
 
-bool Times::delta_walker::for_each (pugi::xml_node& node) {
-    std::string name = node.name();
+        struct Operation {
+            int target;
+            int source;
+            int factor;
+        };
 
-    if (name == "name" || name == "pos" || name == "neg") {
-        value_walker walker;
-        node.traverse(walker);
-        if (name == "name") delta_name = walker.found_value;
-        else if (name == "pos") delta_value += segments[walker.found_value];
-        else delta_value -= segments[walker.found_value];
-    }
+        struct Room {
+            int segment;
+            int steps;
+            int endsteps;
+        };
 
-    return true;
-}
+        std::vector<std::string> names;
+        std::vector<Operation> operations;
+        std::vector<Room> rooms;
+        std::array<int, Areas::Count> areas;
+        std::array<int, Areas::Count> blcons;
+        std::array<int, Segments::Count> segments;
 
-bool Times::def_walker::for_each (pugi::xml_node& node) {
-    std::string name = node.name();
-    if (depth() == 1) {
-        if (name == "delta") {
-            delta_walker walker(segments);
-            node.traverse(walker);
-            segments[walker.delta_name] = walker.delta_value;
+        int id (std::string_view name) {
+            for (int i = 0; i < (int) names.size(); i++) {
+                if (names[i] == name) return i;
+            }
+            names.emplace_back(name);
+            if (names.size() > max_names) throw std::runtime_error("too many names in the time structure");
+            return names.size() - 1;
         }
-    }
-
-    return true;
-}
 
-bool Times::loop_walker::for_each (pugi::xml_node& node) {
-    std::string name = node.name();
-    if (depth() == 0) {
-        std::string name = node.name();
-        if (name == "static" || name == "variant") {
-            value_walker walker;
-            node.traverse(walker);
-            if (name == "static") {
-                segments[area] += times * segments[walker.found_value];
-            } else {
-                if (walker.found_value == "blcon") {
-                    static_blcons[area] += times;
+        Layout () : blcons{} {
+            const Structure::Tables& tables = Structure::tables;
+            for (int segment = 0; segment < Segments::Count; segment++) {
+                segments[segment] = id(segment_info[segment].name);
+            }
+            for (int area = 0; area < Areas::Count; area++) {
+                areas[area] = id(area_names[area]);
+                for (int i = 0; i < tables.area_count; i++) {
+                    if (tables.areas[i] == area_names[area]) blcons[area] = tables.blcons[i];
+                }
+            }
+            for (int i = 0; i < tables.operation_count; i++) {
+                const Structure::Operation& operation = tables.operations[i];
+                int source = operation.source.empty() ? -1 : id(operation.source);
+                operations.push_back({ id(operation.target), source, operation.factor });
+            }
+            for (int i = 0; i < tables.room_count; i++) {
+                std::string room(tables.rooms[i]);
+                int room_id = id(room);
+                for (int segment = 0; segment < Segments::Count; segment++) {
+                    if (segments[segment] == room_id) rooms.push_back({ segment, id(room + "-steps"), id(room + "-endsteps") });
                 }
             }
         }
+    };
+
+    const Layout& get_layout () {
+        static const Layout layout;
+        return layout;
     }
-    return true;
 }
 
-bool Times::structure_walker::for_each (pugi::xml_node& node) {
-    std::string name = node.name();
-    if (depth() == 1) {
-        if (name == "area") {
-            area = node.first_attribute().value();
-            segments[area] = 0;
-            static_blcons[area] = 0;
-        }
-    } else if (depth() == 2) {
-        if (name == "def") {
-            def_walker walker(segments);
-            node.traverse(walker);
-        } else if (name == "static") {
-            value_walker walker;
-            node.traverse(walker);
-            last_static = walker.found_value;
-            segments[area] += segments[walker.found_value];
-        } else if (name == "variant") {
-            value_walker walker;
-            node.traverse(walker);
-            if (walker.found_value == "steps*") {
-                int* steps_value = new int[2];
-                steps_value[0] = segments[last_static + "-steps"];
-                steps_value[1] = segments[last_static + "-endsteps"];
-                steps[last_static] = steps_value;
-            } else if (walker.found_value == "blcon") {
-                static_blcons[area] += 1;
-            }
-        } else if (name == "delta") {
-            delta_walker walker(segments);
-            node.traverse(walker);
-            segments[area] += walker.delta_value;
-        } else if (name == "loop") {
-            std::string times = node.first_attribute().value();
-            if (times != "?") {
-                int loop_times = std::stoi(times);
-                loop_walker walker(segments, static_blcons, area, loop_times);
-                node.traverse(walker);
-            }
+Times::Times (std::unordered_map<std::string, int> map) : Times() {
+    const Layout& layout = get_layout();
+
+    // values by name id, with whether they were recorded
+    std::array<int, Layout::max_names> values {};
+    std::array<bool, Layout::max_names> present {};
+    for (int i = 0; i < (int) layout.names.size(); i++) {
+        auto entry = map.find(layout.names[i]);
+        if (entry != map.end()) {
+            values[i] = entry->second;
+            present[i] = true;
         }
     }
 
-    return true;
+    for (const Layout::Operation& operation : layout.operations) {
+        if (operation.source == -1) values[operation.target] = 0;
+        else values[operation.target] += operation.factor * values[operation.source];
+    }
+
+    for (int area = 0; area < Areas::Count; area++) {
+        static_times[area] = values[layout.areas[area]];
+        static_blcons[area] = layout.blcons[area];
+    }
+
+    for (int segment = 0; segment < Segments::Count; segment++) {
+        segments[segment] = values[layout.segments[segment]];
+        recorded[segment] = present[layout.segments[segment]];
+    }
+
+    for (const Layout::Room& room : layout.rooms) {
+        steps[room.segment] = { values[room.steps], values[room.endsteps] };
+        recorded[room.segment] = recorded[room.segment] && present[room.steps] && present[room.endsteps];
+    }
+}
+
+// make sure every segment needed to simulate an area was recorded, instead of treating the missing ones as 0
+void Times::require (int area) const {
+    for (int segment = 0; segment < Segments::Count; segment++) {
+        if (segment_info[segment].area == area) require_segment(segment);
+    }
+}
+
+void Times::require_segment (int segment) const {
+    if (!recorded[segment]) {
+        throw std::runtime_error(std::string("segment \"") + segment_info[segment].name + "\" was not found in the recordings");
+    }
 }
 
-Times::Times (std::unordered_map<std::string, int> map) {
-    pugi::xml_document doc;
-    pugi::xml_parse_result result = doc.load_string(time_structure);
+// fingerprint of every value an area reads, so results for the area can be reused while it stays the same
+// the segments without an area are the route choices of the ruins
+std::uint64_t Times::area_hash (int area) const {
+    // FNV-1a over the values
+    std::uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash] (std::int64_t value) {
+        for (int byte = 0; byte < 8; byte++) {
+            hash ^= (value >> (8 * byte)) & 0xff;
+            hash *= 1099511628211ull;
+        }
+    };
 
-    segments = map;
-    structure_walker walker(segments, static_blcons, steps);
-    doc.traverse(walker); 
+    mix(static_times[area]);
+    mix(static_blcons[area]);
+    for (int segment = 0; segment < Segments::Count; segment++) {
+        int segment_area = segment_info[segment].area;
+        if (segment_area != area && !(segment_area == Areas::None && area == Areas::Ruins)) continue;
+        mix(segments[segment]);
+        mix(steps[segment][0]);
+        mix(steps[segment][1]);
+        mix(recorded[segment]);
+    }
+    return hash;
 }
\ No newline at end of file
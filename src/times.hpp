@@ -3,102 +3,41 @@
 
 #include <string>
 #include <unordered_map>
-#include "thirdparty/pugixml.hpp"
+#include <array>
+#include <cstdint>
+#include "segments.hpp"
 
 // class stores all the times that rely on execution
+// the segments are resolved into arrays indexed by the ids in `segments.hpp` when built, and never change after that,
+// so the same object can be read by any number of simulations at once
 class Times {
 public:
-    // map keeps track of all recorded and some calculated segments
-    std::unordered_map<std::string, int> segments;
+    // value of every segment read by the simulators
+    std::array<int, Segments::Count> segments;
 
-    // map keeps track of all step information required for fixing
-    std::unordered_map<std::string, int*> steps;
+    // step information required for fixing, indexed by the segment of the room
+    // the first element is the total steps of the path and the second the steps it takes to leave after grinding
+    std::array<std::array<int, 2>, Segments::Count> steps;
 
-    // map keeps track of how many static (guaranted, that is always happen) random "blcon" animations are in a given area
-    std::unordered_map<std::string, int> static_blcons;
+    // time of everything that always happens in an area
+    std::array<int, Areas::Count> static_times;
+
+    // keeps track of how many static (guaranted, that is always happen) random "blcon" animations are in a given area
+    std::array<int, Areas::Count> static_blcons;
+
+    // whether each segment was found in the recordings
+    std::array<bool, Segments::Count> recorded;
     // comments below refer to the name of the segments in the recorder
 
     Times ();
 
     Times (std::unordered_map<std::string, int> map);
 
-    // traverse all of the XML tree to find what the relevant segments are
-    struct structure_walker : pugi::xml_tree_walker {
-        structure_walker (
-            std::unordered_map<std::string, int>& segments,
-            std::unordered_map<std::string, int>& static_blcons,
-            std::unordered_map<std::string, int*>& steps
-        ) : segments(segments), static_blcons(static_blcons), steps(steps) {}
-
-        // references below point to the ones in Times
-        std::unordered_map<std::string, int>& segments;
-        std::unordered_map<std::string, int>& static_blcons;
-        std::unordered_map<std::string, int*>& steps;
-
-        // value of the current area being traversed
-        std::string area;
-
-        // value of the last static node analyzed
-        std::string last_static;
-
-        virtual bool for_each (pugi::xml_node& node);
-    };
-
-    // traverser for the XML tree for a def node
-    struct def_walker : pugi::xml_tree_walker {
-        def_walker (
-            std::unordered_map<std::string, int>& segments
-        ) : segments(segments) {}
-
-        // reference to the `Times` one
-        std::unordered_map<std::string, int>& segments;
-
-        virtual bool for_each (pugi::xml_node& node);
-    };
-
-    // traverser of the delta nodes
-    struct delta_walker : pugi::xml_tree_walker {
-        delta_walker (std::unordered_map<std::string, int>& segments) : segments(segments), delta_value(0) {}
-
-        // reference to the one in `Times`
-        std::unordered_map<std::string, int>& segments;
-
-        // if the delta node has a name (that is inside a def), find its name
-        std::string delta_name;
-
-        // to store the total time of the delta after finishing reading it
-        int delta_value;
-
-        virtual bool for_each (pugi::xml_node& node);
-    };
-
-    // traverse a node to find its value
-    struct value_walker : pugi::xml_tree_walker {
-        // to store the value found
-        std::string found_value;
-
-        virtual bool for_each (pugi::xml_node& node);
-    };
-
-    // traverse a loop node
-    struct loop_walker : pugi::xml_tree_walker {
-        loop_walker (
-            std::unordered_map<std::string, int>& segments,
-            std::unordered_map<std::string, int>& static_blcons,
-            std::string area, int times) : segments(segments), static_blcons(static_blcons), area(area), times(times) {}
-
-        // reference to the ones in `Times`
-        std::unordered_map<std::string, int>& segments;
-        std::unordered_map<std::string, int>& static_blcons;
-
-        // name of the current area
-        std::string area;
+    void require (int area) const;
 
-        // times value found in the loop
-        int times;
+    void require_segment (int segment) const;
 
-        virtual bool for_each (pugi::xml_node& node);
-    };
+    std::uint64_t area_hash (int area) const;
 };
 
 #endif
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include "undertale.hpp"
 #include "random.hpp"
 #include "encounters.hpp"
+#include "importance.hpp"
+#include "sobol.hpp"
 
 // including this method since technically Undertale's rounding at halfway rounds to nearest even number
 // will leave it here for easy of changing that but the difference is technically negligible considering
@@ -11,56 +13,61 @@ int Undertale::round (double number) {
 }
 
 // simulating the round random generator from Mr Tobias
-int Undertale::roundrandom (int max) {
-    return round(Random::random_number() * max);
+template <typename Rng>
+int Undertale::roundrandom (Rng& rng, int max) {
+    return round(rng.random_number() * max);
 }
 // replica of the undertale code, with no optimization in mind
-int Undertale::scr_steps (int min_steps, int steps_delta, int max_kills, int kills) {
+template <typename Rng>
+int Undertale::scr_steps (Rng& rng, SampleContext& context, int min_steps, int steps_delta, int max_kills, int kills) {
     double populationfactor = (double) max_kills / (double) (max_kills - kills);
     if (populationfactor > 8) {
         populationfactor = 8;
     }
-    double steps = (min_steps + roundrandom(steps_delta)) * populationfactor;
+    int roll = roundrandom(rng, steps_delta);
+    // the roll averages half of the delta
+    context.controls[Controls::Steps] += (roll - steps_delta / 2.0) * populationfactor;
+    double steps = (min_steps + roll) * populationfactor;
     return (int) steps + 1;
 }
 
 // step counter for the rooms in the first half of ruins
-int Undertale::ruins_first_half_steps (int kills) {
-    return scr_steps(80, 40, 20, kills);
+template <typename Rng>
+int Undertale::ruins_first_half_steps (Rng& rng, SampleContext& context, int kills) {
+    return scr_steps(rng, context, 80, 40, 20, kills);
 }
 
 // chance of a froggit whiffing at LV 1
-bool Undertale::whiff_lv1_froggit () {
-    double roll = Random::random_number();
-    if (roll < 0.253) return true;
-    return false;
+template <typename Rng>
+bool Undertale::whiff_lv1_froggit (Rng& rng, SampleContext& context) {
+    if (context.record) return Importance::draw(rng, context, DrawSites::WhiffLv1Froggit) == 1;
+    return rng.chance(Random::threshold(0.253));
 }
 
 // encounterer for first half
-int Undertale::ruins1 () {
-    double roll = Random::random_number();
-
-    if (roll < 0.5) return Encounters::SingleFroggit;
-    return Encounters::Whimsun;
+template <typename Rng>
+int Undertale::ruins1 (Rng& rng, SampleContext& context) {
+    context.encounters++;
+    if (context.record) return Importance::draw(rng, context, DrawSites::Ruins1);
+    return EncounterTables::ruins1.pick(rng.next());
 }
 
 // encounterer for ruins second half (called ruins3 because in-game it is the third encounterer)
-int Undertale::ruins3 () {
-    double roll = Random::random_number();
-    if (roll < 0.25) return Encounters::FroggitWhimsun;
-    if (roll < 0.5) return Encounters::SingleMoldsmal;
-    if (roll < 0.75) return Encounters::TripleMoldsmal;
-    if (roll < 0.9) return Encounters::DoubleFroggit;
-    return Encounters::DoubleMoldsmal;
+template <typename Rng>
+int Undertale::ruins3 (Rng& rng, SampleContext& context) {
+    context.encounters++;
+    if (context.record) return Importance::draw(rng, context, DrawSites::Ruins3);
+    return EncounterTables::ruins3.pick(rng.next());
 }
 
 // random odds for a frog skip
 // 1 = no frogskip
 // 0 = gets frogskip
 // choice of these numbers comes from how the simulator and recorder work (by default frogskip is assumed)
-int Undertale::frogskip () {
-    double roll = Random::random_number();
-    if (roll < 0.405) return 0;
+template <typename Rng>
+int Undertale::frogskip (Rng& rng, SampleContext& context) {
+    if (context.record) return Importance::draw(rng, context, DrawSites::Frogskip);
+    if (rng.chance(Random::threshold(0.405))) return 0;
     return 1;
 }
 
@@ -68,16 +75,19 @@ int Undertale::frogskip () {
 int Undertale::heart_flick = 47;
 
 // total time required to enter an encounter (blcon + flick) using random values
-int Undertale::encounter_time_random () {
-    return encounter_time_random(1);
+template <typename Rng>
+int Undertale::encounter_time_random (Rng& rng, SampleContext& context) {
+    return encounter_time_random(rng, context, 1);
 }
 
 // total time required to enter an encounter (blcon + flick) a number of times using random values
-int Undertale::encounter_time_random(int number_of_times) {
+template <typename Rng>
+int Undertale::encounter_time_random (Rng& rng, SampleContext& context, int number_of_times) {
     int total = heart_flick * number_of_times;
     for (int i = 0; i < number_of_times; i++) {
-        total += roundrandom(5);
+        total += roundrandom(rng, 5);
     }
+    context.controls[Controls::Blcons] += total - (heart_flick + 2.5) * number_of_times;
     return total;
 }
 
@@ -88,79 +98,271 @@ int Undertale::encounter_time_average_total (int number_of_times) {
 }
 
 // snowdin grind encounter results
-int Undertale::snowdin () {
-    double roll = Random::random_number();
-    if (roll > 0.5) return Encounters::SnowdinDouble;
-    else return Encounters::SnowdinTriple;
+template <typename Rng>
+int Undertale::snowdin (Rng& rng, SampleContext& context) {
+    context.encounters++;
+    if (context.record) return Importance::draw(rng, context, DrawSites::Snowdin);
+    return EncounterTables::snowdin.pick(rng.next());
 }
 
-int Undertale::dogi_room_steps (int kills) {
-    return scr_steps(220, 30, 16, kills);
+template <typename Rng>
+int Undertale::dogi_room_steps (Rng& rng, SampleContext& context, int kills) {
+    return scr_steps(rng, context, 220, 30, 16, kills);
 }
 
-int Undertale::snowdin_general_steps (int kills) {
-    return scr_steps(120, 30, 16, kills);
+template <typename Rng>
+int Undertale::snowdin_general_steps (Rng& rng, SampleContext& context, int kills) {
+    return scr_steps(rng, context, 120, 30, 16, kills);
 }
 
 // getting a dogskip or not
 // 0 - no dogskip
 // 1 - dogskip
-int Undertale::dogskip () {
-    double roll = Random::random_number();
-    if (roll < 0.5) return 0;
+template <typename Rng>
+int Undertale::dogskip (Rng& rng) {
+    if (rng.chance(Random::threshold(0.5))) return 0;
     else return 1;
 }
 
 // encounters for the first random encounter in Waterfall
-int Undertale::glowing_water_encounter () {
-    double roll = Random::random_number();
-    if (roll < 0.2666666666) {
-        return Encounters::SingleWoshua;
-    }
-    if (roll < 0.53333333333) {
-        return Encounters::DoubleMoldsmal;
-    } 
-    if (roll < 0.7333333333) {
-        return Encounters::SingleAaron;
-    }
-    return Encounters::WoshuaAaron;
-
+template <typename Rng>
+int Undertale::glowing_water_encounter (Rng& rng, SampleContext& context) {
+    context.encounters++;
+    if (context.record) return Importance::draw(rng, context, DrawSites::GlowingWater);
+    return EncounterTables::glowing_water.pick(rng.next());
 }
 
-int Undertale::glowing_water_steps (int kills) {
-    return scr_steps(360, 30, 18, kills);
+template <typename Rng>
+int Undertale::glowing_water_steps (Rng& rng, SampleContext& context, int kills) {
+    return scr_steps(rng, context, 360, 30, 18, kills);
 }
 
 // random encounters at the end of Waterfall
-int Undertale::waterfall_grind_encounter () {
-    double roll = Random::random_number();
-    if (roll < 0.33333333) return Encounters::WoshuaAaron;
-    if (roll < 0.73333333) return Encounters::WoshuaMoldbygg;
-    return Encounters::Temmie;
+template <typename Rng>
+int Undertale::waterfall_grind_encounter (Rng& rng, SampleContext& context) {
+    context.encounters++;
+    if (context.record) return Importance::draw(rng, context, DrawSites::WaterfallGrind);
+    return EncounterTables::waterfall_grind.pick(rng.next());
 }
 
 // steps for the rooms in the waterfall grind
-int Undertale::waterfall_grind_steps (int kills) {
-    return scr_steps(60, 20, 18, kills);
+template <typename Rng>
+int Undertale::waterfall_grind_steps (Rng& rng, SampleContext& context, int kills) {
+    return scr_steps(rng, context, 60, 20, 18, kills);
 }
 
 // steps for the same rooms as `waterfall_grind_steps` without a transition
-int Undertale::waterfall_grind_same_room (int kills) {
-    return scr_steps(120, 50, 18, kills);
+template <typename Rng>
+int Undertale::waterfall_grind_same_room (Rng& rng, SampleContext& context, int kills) {
+    return scr_steps(rng, context, 120, 50, 18, kills);
 }
 
 // steps for the rooms in core
-int Undertale::core_encounter () {
-    double roll = Random::random_number();
-    if (roll < 0.133333333) return Encounters::FinalFroggitAstigmatism;
-    if (roll < 0.333333333) return Encounters::WhimsalotFinalFroggit;
-    if (roll < 0.533333333) return Encounters::WhimsalotAstigmatism;
-    if (roll < 0.733333333) return Encounters::KnightKnightMadjick;
-    if (roll < 0.866666666) return Encounters::CoreTriple;
-    if (roll < 0.933333333) return Encounters::SingleKnightKnight;
-    return Encounters::SingleMadjick;
-}
-
-int Undertale::core_steps (int kills) {
-    return scr_steps(70, 50, 40, kills);
+template <typename Rng>
+int Undertale::core_encounter (Rng& rng, SampleContext& context) {
+    context.encounters++;
+    if (context.record) return Importance::draw(rng, context, DrawSites::Core);
+    return EncounterTables::core.pick(rng.next());
+}
+
+template <typename Rng>
+int Undertale::core_steps (Rng& rng, SampleContext& context, int kills) {
+    return scr_steps(rng, context, 70, 50, 40, kills);
+}
+
+// the draws of the simulations are either random or quasi-random
+template int Undertale::scr_steps (Random&, SampleContext&, int, int, int, int);
+template int Undertale::ruins_first_half_steps (Random&, SampleContext&, int);
+template bool Undertale::whiff_lv1_froggit (Random&, SampleContext&);
+template int Undertale::ruins1 (Random&, SampleContext&);
+template int Undertale::ruins3 (Random&, SampleContext&);
+template int Undertale::frogskip (Random&, SampleContext&);
+template int Undertale::encounter_time_random (Random&, SampleContext&);
+template int Undertale::encounter_time_random (Random&, SampleContext&, int);
+template int Undertale::snowdin (Random&, SampleContext&);
+template int Undertale::dogi_room_steps (Random&, SampleContext&, int);
+template int Undertale::snowdin_general_steps (Random&, SampleContext&, int);
+template int Undertale::dogskip (Random&);
+template int Undertale::glowing_water_encounter (Random&, SampleContext&);
+template int Undertale::glowing_water_steps (Random&, SampleContext&, int);
+template int Undertale::waterfall_grind_encounter (Random&, SampleContext&);
+template int Undertale::waterfall_grind_steps (Random&, SampleContext&, int);
+template int Undertale::waterfall_grind_same_room (Random&, SampleContext&, int);
+template int Undertale::core_encounter (Random&, SampleContext&);
+template int Undertale::core_steps (Random&, SampleContext&, int);
+
+template int Undertale::scr_steps (QuasiRandom&, SampleContext&, int, int, int, int);
+template int Undertale::ruins_first_half_steps (QuasiRandom&, SampleContext&, int);
+template bool Undertale::whiff_lv1_froggit (QuasiRandom&, SampleContext&);
+template int Undertale::ruins1 (QuasiRandom&, SampleContext&);
+template int Undertale::ruins3 (QuasiRandom&, SampleContext&);
+template int Undertale::frogskip (QuasiRandom&, SampleContext&);
+template int Undertale::encounter_time_random (QuasiRandom&, SampleContext&);
+template int Undertale::encounter_time_random (QuasiRandom&, SampleContext&, int);
+template int Undertale::snowdin (QuasiRandom&, SampleContext&);
+template int Undertale::dogi_room_steps (QuasiRandom&, SampleContext&, int);
+template int Undertale::snowdin_general_steps (QuasiRandom&, SampleContext&, int);
+template int Undertale::dogskip (QuasiRandom&);
+template int Undertale::glowing_water_encounter (QuasiRandom&, SampleContext&);
+template int Undertale::glowing_water_steps (QuasiRandom&, SampleContext&, int);
+template int Undertale::waterfall_grind_encounter (QuasiRandom&, SampleContext&);
+template int Undertale::waterfall_grind_steps (QuasiRandom&, SampleContext&, int);
+template int Undertale::waterfall_grind_same_room (QuasiRandom&, SampleContext&, int);
+template int Undertale::core_encounter (QuasiRandom&, SampleContext&);
+template int Undertale::core_steps (QuasiRandom&, SampleContext&, int);
+
+// the chances below must match the rolls of the methods above
+
+// `round` splits [0, 1] evenly except at the ends, where only half of an interval is left
+Chances Undertale::roundrandom_chances (int max) {
+    Chances chances;
+    for (int i = 0; i <= max; i++) {
+        chances.push_back({ i, (i == 0 || i == max ? 0.5 : 1.0) / max });
+    }
+    return chances;
+}
+
+Chances Undertale::scr_steps_chances (int min_steps, int steps_delta, int max_kills, int kills) {
+    double populationfactor = (double) max_kills / (double) (max_kills - kills);
+    if (populationfactor > 8) {
+        populationfactor = 8;
+    }
+    Chances chances;
+    for (const auto& roll : roundrandom_chances(steps_delta)) {
+        double steps = (min_steps + roll.first) * populationfactor;
+        chances.push_back({ (int) steps + 1, roll.second });
+    }
+    return chances;
+}
+
+Chances Undertale::ruins_first_half_steps_chances (int kills) {
+    return scr_steps_chances(80, 40, 20, kills);
+}
+
+double Undertale::whiff_lv1_froggit_chance () {
+    return 0.253;
+}
+
+Chances Undertale::ruins1_chances () {
+    return EncounterTables::ruins1.get_chances();
+}
+
+Chances Undertale::ruins3_chances () {
+    return EncounterTables::ruins3.get_chances();
+}
+
+Chances Undertale::frogskip_chances () {
+    return { { 0, 0.405 }, { 1, 0.595 } };
+}
+
+ProbabilityDistribution Undertale::encounter_time_chances (int number_of_times) {
+    ProbabilityDistribution total({ { heart_flick * number_of_times, 1 } });
+    ProbabilityDistribution blcon(roundrandom_chances(5));
+    for (int i = 0; i < number_of_times; i++) {
+        total.convolve(blcon);
+    }
+    return total;
+}
+
+Chances Undertale::snowdin_chances () {
+    return EncounterTables::snowdin.get_chances();
+}
+
+Chances Undertale::dogi_room_steps_chances (int kills) {
+    return scr_steps_chances(220, 30, 16, kills);
+}
+
+Chances Undertale::snowdin_general_steps_chances (int kills) {
+    return scr_steps_chances(120, 30, 16, kills);
+}
+
+Chances Undertale::glowing_water_encounter_chances () {
+    return EncounterTables::glowing_water.get_chances();
+}
+
+Chances Undertale::glowing_water_steps_chances (int kills) {
+    return scr_steps_chances(360, 30, 18, kills);
+}
+
+Chances Undertale::waterfall_grind_encounter_chances () {
+    return EncounterTables::waterfall_grind.get_chances();
+}
+
+Chances Undertale::waterfall_grind_steps_chances (int kills) {
+    return scr_steps_chances(60, 20, 18, kills);
+}
+
+Chances Undertale::waterfall_grind_same_room_chances (int kills) {
+    return scr_steps_chances(120, 50, 18, kills);
+}
+
+Chances Undertale::core_encounter_chances () {
+    return EncounterTables::core.get_chances();
+}
+
+Chances Undertale::core_steps_chances (int kills) {
+    return scr_steps_chances(70, 50, 40, kills);
+}
+
+// the batched methods below draw for every lane, even for the lanes whose simulation already ended,
+// to keep the loops free of branches
+
+void Undertale::roundrandom (RandomLanes& lanes, int max, int* out) {
+    alignas(64) double rolls[RandomLanes::size];
+    lanes.random_numbers(rolls);
+    #pragma omp simd
+    for (int lane = 0; lane < RandomLanes::size; lane++) {
+        // same as `round` for positive numbers
+        out[lane] = (int)(rolls[lane] * max + 0.5);
+    }
+}
+
+void Undertale::scr_steps (RandomLanes& lanes, int min_steps, int steps_delta, int max_kills, const int* kills, int* out) {
+    alignas(64) int rolls[RandomLanes::size];
+    roundrandom(lanes, steps_delta, rolls);
+    #pragma omp simd
+    for (int lane = 0; lane < RandomLanes::size; lane++) {
+        // finished lanes may be past the maximum, which would divide by zero
+        int remaining = max_kills - kills[lane];
+        if (remaining < 1) remaining = 1;
+        double populationfactor = (double) max_kills / (double) remaining;
+        if (populationfactor > 8) populationfactor = 8;
+        out[lane] = (int)((min_steps + rolls[lane]) * populationfactor) + 1;
+    }
+}
+
+void Undertale::encounter_time_random (RandomLanes& lanes, int number_of_times, int* out) {
+    alignas(64) int rolls[RandomLanes::size];
+    for (int lane = 0; lane < RandomLanes::size; lane++) {
+        out[lane] = heart_flick * number_of_times;
+    }
+    for (int i = 0; i < number_of_times; i++) {
+        roundrandom(lanes, 5, rolls);
+        #pragma omp simd
+        for (int lane = 0; lane < RandomLanes::size; lane++) {
+            out[lane] += rolls[lane];
+        }
+    }
+}
+
+// the encounter of every lane, from the same table
+static void pick_encounter (RandomLanes& lanes, const EncounterTable& table, int* out) {
+    alignas(64) std::uint64_t rolls[RandomLanes::size];
+    lanes.next(rolls);
+    #pragma omp simd
+    for (int lane = 0; lane < RandomLanes::size; lane++) {
+        out[lane] = table.pick(rolls[lane]);
+    }
+}
+
+void Undertale::ruins1 (RandomLanes& lanes, int* out) {
+    pick_encounter(lanes, EncounterTables::ruins1, out);
+}
+
+void Undertale::ruins3 (RandomLanes& lanes, int* out) {
+    pick_encounter(lanes, EncounterTables::ruins3, out);
+}
+
+void Undertale::core_encounter (RandomLanes& lanes, int* out) {
+    pick_encounter(lanes, EncounterTables::core, out);
 }
\ No newline at end of file
@@ -1,54 +1,130 @@
 #ifndef UNDERTALE_H
 #define UNDERTALE_H
 
+#include "random.hpp"
+#include "sample_context.hpp"
+#include "probability_distribution.hpp"
+
 // handle methods specific to the undertale engine
 class Undertale {
 private:
     static int round (double number);
 
-    static int roundrandom (int max);
+    template <typename Rng>
+    static int roundrandom (Rng& rng, int max);
+
+    static void roundrandom (RandomLanes& lanes, int max, int* out);
+
+    static Chances roundrandom_chances (int max);
 public:
-    static int scr_steps (int min_steps, int steps_delta, int max_kills, int kills);
+    template <typename Rng>
+    static int scr_steps (Rng& rng, SampleContext& context, int min_steps, int steps_delta, int max_kills, int kills);
 
-    static int ruins_first_half_steps (int kills);
+    template <typename Rng>
+    static int ruins_first_half_steps (Rng& rng, SampleContext& context, int kills);
 
-    static bool whiff_lv1_froggit ();
+    template <typename Rng>
+    static bool whiff_lv1_froggit (Rng& rng, SampleContext& context);
 
-    static int ruins1 ();
+    template <typename Rng>
+    static int ruins1 (Rng& rng, SampleContext& context);
 
-    static int ruins3 ();
+    template <typename Rng>
+    static int ruins3 (Rng& rng, SampleContext& context);
 
-    static int frogskip ();
+    template <typename Rng>
+    static int frogskip (Rng& rng, SampleContext& context);
 
     static int heart_flick;
 
-    static int encounter_time_random ();
+    template <typename Rng>
+    static int encounter_time_random (Rng& rng, SampleContext& context);
 
-    static int encounter_time_random(int number_of_times);
+    template <typename Rng>
+    static int encounter_time_random (Rng& rng, SampleContext& context, int number_of_times);
 
     static int encounter_time_average_total (int number_of_times);
 
-    static int snowdin ();
+    template <typename Rng>
+    static int snowdin (Rng& rng, SampleContext& context);
+
+    template <typename Rng>
+    static int dogi_room_steps (Rng& rng, SampleContext& context, int kills);
+
+    template <typename Rng>
+    static int snowdin_general_steps (Rng& rng, SampleContext& context, int kills);
+
+    template <typename Rng>
+    static int dogskip (Rng& rng);
+
+    template <typename Rng>
+    static int glowing_water_encounter (Rng& rng, SampleContext& context);
+
+    template <typename Rng>
+    static int glowing_water_steps (Rng& rng, SampleContext& context, int kills);
+
+    template <typename Rng>
+    static int waterfall_grind_encounter (Rng& rng, SampleContext& context);
+
+    template <typename Rng>
+    static int waterfall_grind_steps (Rng& rng, SampleContext& context, int kills);
+
+    template <typename Rng>
+    static int waterfall_grind_same_room (Rng& rng, SampleContext& context, int kills);
+
+    template <typename Rng>
+    static int core_encounter (Rng& rng, SampleContext& context);
+
+    template <typename Rng>
+    static int core_steps (Rng& rng, SampleContext& context, int kills);
+
+    // chances of every result of the methods above, for calculating exact distributions
+
+    static Chances scr_steps_chances (int min_steps, int steps_delta, int max_kills, int kills);
+
+    static Chances ruins_first_half_steps_chances (int kills);
+
+    static double whiff_lv1_froggit_chance ();
+
+    static Chances ruins1_chances ();
+
+    static Chances ruins3_chances ();
+
+    static Chances frogskip_chances ();
+
+    static ProbabilityDistribution encounter_time_chances (int number_of_times);
+
+    static Chances snowdin_chances ();
+
+    static Chances dogi_room_steps_chances (int kills);
+
+    static Chances snowdin_general_steps_chances (int kills);
+
+    static Chances glowing_water_encounter_chances ();
+
+    static Chances glowing_water_steps_chances (int kills);
+
+    static Chances waterfall_grind_encounter_chances ();
 
-    static int dogi_room_steps (int kills);
+    static Chances waterfall_grind_steps_chances (int kills);
 
-    static int snowdin_general_steps (int kills);
+    static Chances waterfall_grind_same_room_chances (int kills);
 
-    static int dogskip ();
+    static Chances core_encounter_chances ();
 
-    static int glowing_water_encounter ();
+    static Chances core_steps_chances (int kills);
 
-    static int glowing_water_steps (int kills);
+    // batched versions of the methods above, each writing one result per lane of `lanes`
 
-    static int waterfall_grind_encounter ();
+    static void scr_steps (RandomLanes& lanes, int min_steps, int steps_delta, int max_kills, const int* kills, int* out);
 
-    static int waterfall_grind_steps (int kills);
+    static void encounter_time_random (RandomLanes& lanes, int number_of_times, int* out);
 
-    static int waterfall_grind_same_room (int kills);
+    static void ruins1 (RandomLanes& lanes, int* out);
 
-    static int core_encounter ();
+    static void ruins3 (RandomLanes& lanes, int* out);
 
-    static int core_steps (int kills);
+    static void core_encounter (RandomLanes& lanes, int* out);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include "usage_model.hpp"
+#include "simulator.hpp"
+
+// first bytes of the file, changed whenever its layout changes
+static const char model_magic[8] = { 'U', 'S', 'A', 'G', 'E', '0', '0', '1' };
+
+void SampleUsage::clear () {
+    std::fill(counts, counts + usage_indexes, 0);
+    room_count = 0;
+}
+
+UsageModel::UsageModel () : room_slots(0) {}
+
+// area of an index of `SampleUsage::counts`, the segments without an area being the route choices of the ruins
+int UsageModel::get_area (int index) {
+    if (index >= Segments::Count) return index - Segments::Count;
+    int area = segment_info[index].area;
+    return area == Areas::None ? Areas::Ruins : area;
+}
+
+std::int64_t UsageModel::get_samples () const {
+    return random_frames.size();
+}
+
+// time of every pattern, the reads of the times only depending on the pattern
+std::vector<std::int64_t> UsageModel::get_pattern_times (const Times& times) const {
+    std::vector<std::int64_t> pattern_times(patterns.size());
+    for (std::size_t pattern = 0; pattern < patterns.size(); pattern++) {
+        for (const auto& [index, uses] : patterns[pattern].counts) {
+            int value = index < Segments::Count ? times.segments[index] : times.static_times[index - Segments::Count];
+            pattern_times[pattern] += (std::int64_t) uses * value;
+        }
+    }
+    return pattern_times;
+}
+
+std::int64_t UsageModel::get_time (std::int64_t sample, const std::vector<std::int64_t>& pattern_times, const Times& times) const {
+    std::int64_t time = random_frames[sample];
+    const std::int16_t* steps = &room_steps[sample * room_slots];
+    for (int area = 0; area < Areas::Count; area++) {
+        std::uint32_t id = sample_patterns[sample * Areas::Count + area];
+        time += pattern_times[id];
+        for (int room : patterns[id].rooms) {
+            time += Simulator::fix_step_total(times, *steps++, room);
+        }
+    }
+    return time;
+}
+
+// distribution of the stored simulations with other times, without simulating
+ProbabilityDistribution UsageModel::evaluate (const Times& times, int threads) const {
+    std::vector<std::int64_t> pattern_times = get_pattern_times(times);
+    std::vector<ProbabilityDistribution> worker_dists(threads, ProbabilityDistribution(1));
+    #pragma omp parallel for schedule(static, 1) num_threads(threads)
+    for (int worker = 0; worker < threads; worker++) {
+        auto [first, end] = Simulator::worker_range(get_samples(), worker, threads);
+        for (std::int64_t sample = first; sample < end; sample++) {
+            worker_dists[worker].add_value(get_time(sample, pattern_times, times));
+        }
+    }
+
+    ProbabilityDistribution dist(1);
+    for (int worker = 0; worker < threads; worker++) {
+        dist.add(worker_dists[worker]);
+    }
+    return dist;
+}
+
+// how the times read by the simulations move from `before` to `after`, as (index in `SampleUsage::counts`, frames)
+TimesChange UsageModel::get_change (const Times& before, const Times& after) {
+    TimesChange change;
+    for (int segment = 0; segment < Segments::Count; segment++) {
+        int frames = after.segments[segment] - before.segments[segment];
+        if (frames != 0) change.push_back({ segment, frames });
+    }
+    for (int area = 0; area < Areas::Count; area++) {
+        int frames = after.static_times[area] - before.static_times[area];
+        if (frames != 0) change.push_back({ Segments::Count + area, frames });
+    }
+    return change;
+}
+
+// how every change of the times moves the average and the chance of being under `max`, all from the same simulations
+// the time of a simulation is linear in the times, so a change moves it by the uses of each index times its frames,
+// and the derivative of the chance is the density of the times at `max` weighted by how much they move,
+// estimated with a kernel around `max`; the changes are taken as taking time off, so gains are positive
+std::vector<Sensitivity> UsageModel::get_sensitivities (
+    const Times& times, int max, const std::vector<TimesChange>& changes, int threads
+) const {
+    std::int64_t samples = get_samples();
+    std::vector<Sensitivity> sensitivities(changes.size());
+    if (samples == 0) return sensitivities;
+
+    // bandwidth of the kernel from the spread of the times (Silverman's rule), at least a frame
+    double stdev = evaluate(times, threads).get_stdev();
+    double bandwidth = std::max(1.0, 1.06 * stdev * std::pow((double) samples, -0.2));
+
+    // total uses of every index, and the kernel weighted time saved by every change (with its squares)
+    struct WorkerSums {
+        std::vector<double> uses;
+        std::vector<double> weighted;
+        std::vector<double> weighted_squares;
+    };
+    std::vector<WorkerSums> worker_sums(threads);
+    std::vector<std::int64_t> pattern_times = get_pattern_times(times);
+    #pragma omp parallel for schedule(static, 1) num_threads(threads)
+    for (int worker = 0; worker < threads; worker++) {
+        WorkerSums& sums = worker_sums[worker];
+        sums.uses.assign(usage_indexes, 0);
+        sums.weighted.assign(changes.size(), 0);
+        sums.weighted_squares.assign(changes.size(), 0);
+        // uses of the current simulation
+        std::vector<int> uses(usage_indexes);
+        auto [first, end] = Simulator::worker_range(get_samples(), worker, threads);
+        for (std::int64_t sample = first; sample < end; sample++) {
+            // being under `max` is being at most `max - 1`, so the edge is halfway between them
+            double distance = (get_time(sample, pattern_times, times) - (max - 0.5)) / bandwidth;
+            // Epanechnikov kernel, which is 0 for the simulations far from `max`
+            double weight = std::abs(distance) < 1 ? 0.75 * (1 - distance * distance) / bandwidth : 0;
+            for (int area = 0; area < Areas::Count; area++) {
+                for (const auto& [index, count] : patterns[sample_patterns[sample * Areas::Count + area]].counts) {
+                    sums.uses[index] += count;
+                    uses[index] = count;
+                }
+            }
+            if (weight != 0) {
+                for (std::size_t change = 0; change < changes.size(); change++) {
+                    double saved = 0;
+                    for (const auto& [index, frames] : changes[change]) saved -= (double) uses[index] * frames;
+                    sums.weighted[change] += weight * saved;
+                    sums.weighted_squares[change] += weight * saved * weight * saved;
+                }
+            }
+            for (int area = 0; area < Areas::Count; area++) {
+                for (const auto& pair : patterns[sample_patterns[sample * Areas::Count + area]].counts) {
+                    uses[pair.first] = 0;
+                }
+            }
+        }
+    }
+
+    std::vector<double> uses(usage_indexes);
+    for (const WorkerSums& sums : worker_sums) {
+        for (int index = 0; index < usage_indexes; index++) uses[index] += sums.uses[index];
+    }
+    for (std::size_t change = 0; change < changes.size(); change++) {
+        Sensitivity& sensitivity = sensitivities[change];
+        double weighted = 0, weighted_squares = 0;
+        for (const WorkerSums& sums : worker_sums) {
+            weighted += sums.weighted[change];
+            weighted_squares += sums.weighted_squares[change];
+        }
+        sensitivity.time = 0;
+        for (const auto& [index, frames] : changes[change]) sensitivity.time -= uses[index] * frames / samples;
+        sensitivity.chance = weighted / samples;
+        double variance = std::max(0.0, weighted_squares / samples - sensitivity.chance * sensitivity.chance);
+        // 99% confidence interval, like the rest of the margins
+        sensitivity.margin = 2.576 * std::sqrt(variance / samples);
+    }
+    return sensitivities;
+}
+
+// the patterns, followed by every column of the simulations
+void UsageModel::save (const std::string& path) const {
+    std::string buffer(model_magic, sizeof(model_magic));
+    auto write = [&buffer] (const auto& value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    auto write_array = [&buffer] (const auto& values) {
+        buffer.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(values[0]));
+    };
+
+    write((std::uint32_t) description.size());
+    buffer += description;
+    write((std::uint32_t) patterns.size());
+    for (const Pattern& pattern : patterns) {
+        write((std::uint32_t) pattern.counts.size());
+        for (const auto& [index, uses] : pattern.counts) {
+            write((std::int32_t) index);
+            write((std::int32_t) uses);
+        }
+        write((std::uint32_t) pattern.rooms.size());
+        for (int room : pattern.rooms) {
+            write((std::int32_t) room);
+        }
+    }
+    write((std::uint64_t) get_samples());
+    write((std::int32_t) room_slots);
+    write_array(sample_patterns);
+    write_array(random_frames);
+    write_array(room_steps);
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(buffer.data(), buffer.size());
+}
+
+// read a model saved with `save`, returning false if the file is missing, cut or corrupted
+bool UsageModel::load (const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::string buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const char* pos = buffer.data();
+    const char* end = pos + buffer.size();
+
+    auto read = [&] (void* out, std::size_t size) {
+        if ((std::size_t) (end - pos) < size) return false;
+        std::memcpy(out, pos, size);
+        pos += size;
+        return true;
+    };
+    auto read_array = [&] (auto& values, std::uint64_t count) {
+        if ((std::size_t) (end - pos) / sizeof(values[0]) < count) return false;
+        values.resize(count);
+        return read(values.data(), count * sizeof(values[0]));
+    };
+
+    char magic[sizeof(model_magic)];
+    std::uint32_t length;
+    if (!read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), model_magic)) return false;
+    if (!read(&length, sizeof(length)) || (std::size_t) (end - pos) < length) return false;
+    description.assign(pos, length);
+    pos += length;
+
+    std::uint32_t pattern_count;
+    if (!read(&pattern_count, sizeof(pattern_count))) return false;
+    patterns.assign(pattern_count, Pattern());
+    for (Pattern& pattern : patterns) {
+        std::uint32_t count;
+        if (!read(&count, sizeof(count))) return false;
+        for (std::uint32_t i = 0; i < count; i++) {
+            std::int32_t entry[2];
+            if (!read(entry, sizeof(entry)) || entry[0] < 0 || entry[0] >= usage_indexes) return false;
+            pattern.counts.push_back({ entry[0], entry[1] });
+        }
+        if (!read(&count, sizeof(count)) || count > SampleUsage::max_rooms) return false;
+        for (std::uint32_t i = 0; i < count; i++) {
+            std::int32_t room;
+            if (!read(&room, sizeof(room)) || room < 0 || room >= Segments::Count) return false;
+            pattern.rooms.push_back(room);
+        }
+    }
+
+    std::uint64_t samples;
+    std::int32_t slots;
+    if (!read(&samples, sizeof(samples)) || !read(&slots, sizeof(slots)) || slots < 0 || slots > SampleUsage::max_rooms) return false;
+    room_slots = slots;
+    if (!read_array(sample_patterns, samples * Areas::Count) || !read_array(random_frames, samples) ||
+        !read_array(room_steps, samples * room_slots)) return false;
+    for (std::size_t sample = 0; sample < samples; sample++) {
+        std::size_t rooms = 0;
+        for (int area = 0; area < Areas::Count; area++) {
+            std::uint32_t id = sample_patterns[sample * Areas::Count + area];
+            if (id >= pattern_count) return false;
+            rooms += patterns[id].rooms.size();
+        }
+        if (rooms > (std::size_t) room_slots) return false;
+    }
+    return true;
+}
\ No newline at end of file
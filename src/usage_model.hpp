@@ -0,0 +1,91 @@
+#ifndef USAGE_MODEL_H
+#define USAGE_MODEL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "segments.hpp"
+#include "times.hpp"
+#include "probability_distribution.hpp"
+
+// indexes of `SampleUsage::counts`: every segment, then the static time of every area
+constexpr int usage_indexes = int(Segments::Count) + int(Areas::Count);
+
+// what a simulation read from the times, recorded through `SampleContext::usage`
+struct SampleUsage {
+    // most rooms a simulation can fix the steps of
+    static const int max_rooms = 8;
+
+    // times each segment was used, followed by the times the static time of each area was
+    std::int32_t counts [usage_indexes];
+
+    // rooms given to `Simulator::fix_step_total` in order, with the steps calculated for them
+    int room_count;
+    int rooms [max_rooms];
+    int steps [max_rooms];
+
+    void clear ();
+};
+
+// a change of the times read by the simulations, as (index in `SampleUsage::counts`, frames)
+typedef std::vector<std::pair<int, int>> TimesChange;
+
+// how a change of the times moves the results of a run
+struct Sensitivity {
+    // frames taken off the average time
+    double time;
+    // chance of being under the time gained, and its margin of error (99% confidence)
+    double chance;
+    double margin;
+};
+
+// simulations stored as what they read from the times instead of their time, so they can be timed again for any times
+// the time of a simulation is its random frames (blcons, steps and so on), plus every segment times its uses,
+// plus the fixed steps of its rooms; none of the random draws depend on the times, so the same simulations stay valid
+// what a simulation read in each area is a pattern, shared by every simulation that read the same segments
+// the same number of times there, so a simulation only stores its patterns, its random frames and the steps of its rooms
+class UsageModel {
+public:
+    // the segments used in an area, as (index in `SampleUsage::counts`, uses), and the rooms with fixed steps
+    struct Pattern {
+        std::vector<std::pair<int, int>> counts;
+        std::vector<int> rooms;
+    };
+
+    std::vector<Pattern> patterns;
+
+    // for every simulation: the pattern of each area, its random frames,
+    // and the steps of the rooms of its patterns in order (`room_slots` per simulation)
+    std::vector<std::uint32_t> sample_patterns;
+    std::vector<std::int32_t> random_frames;
+    std::vector<std::int16_t> room_steps;
+    int room_slots;
+
+    // what the simulations were made with, checked when reading the model from a file
+    std::string description;
+
+    UsageModel ();
+
+    static int get_area (int index);
+
+    std::int64_t get_samples () const;
+
+    ProbabilityDistribution evaluate (const Times& times, int threads) const;
+
+    static TimesChange get_change (const Times& before, const Times& after);
+
+    std::vector<Sensitivity> get_sensitivities (
+        const Times& times, int max, const std::vector<TimesChange>& changes, int threads
+    ) const;
+
+    void save (const std::string& path) const;
+
+    bool load (const std::string& path);
+
+private:
+    std::vector<std::int64_t> get_pattern_times (const Times& times) const;
+
+    std::int64_t get_time (std::int64_t sample, const std::vector<std::int64_t>& pattern_times, const Times& times) const;
+};
+
+#endif
\ No newline at end of file
@@ -6,7 +6,7 @@
 #include "utils.hpp"
 #include <iostream>
 
-int Utils::time_to_frame (char* time) {
+int Utils::time_to_frame (const char* time) {
     std::vector<std::string> numbers = std::vector<std::string>();
     numbers.push_back("");
     int number_count = 0;
@@ -43,4 +43,21 @@ std::string Utils::frame_to_time (int frame) {
               << std::setfill('0') << std::setw(2) << remaining_seconds;
 
     return time_stream.str();
+}
+
+// read a time given either as a number of frames or as "mm:ss" / "hh:mm:ss"
+int Utils::parse_frames (const std::string& text) {
+    if (text.find(':') == std::string::npos) return std::stoi(text);
+    return time_to_frame(text.c_str());
+}
+
+// break a list like "1,2,3" into its elements
+std::vector<std::string> Utils::split (const std::string& text, char separator) {
+    std::vector<std::string> elements;
+    std::stringstream stream(text);
+    std::string element;
+    while (std::getline(stream, element, separator)) {
+        if (!element.empty()) elements.push_back(element);
+    }
+    return elements;
 }
\ No newline at end of file
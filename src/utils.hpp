@@ -1,11 +1,18 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <string>
+#include <vector>
+
 class Utils {
 public:
-    static int time_to_frame (char* time);
+    static int time_to_frame (const char* time);
 
     static std::string frame_to_time (int frame);
+
+    static int parse_frames (const std::string& text);
+
+    static std::vector<std::string> split (const std::string& text, char separator);
 };
 
 #endif
\ No newline at end of file
@@ -1,46 +1,58 @@
 #include "waterfall.hpp"
 #include "undertale.hpp"
 #include "encounters.hpp"
+#include <tuple>
 
-Waterfall::Waterfall (Times& times_value) : Simulator(times_value) {}
+Waterfall::Waterfall (const Times& times_value) : Simulator(times_value) {
+    times.require(Areas::Waterfall);
+}
+
+Simulator* Waterfall::clone (const Times& times_value) {
+    return new Waterfall(times_value);
+}
+
+std::string Waterfall::get_cache_key () {
+    return get_area_key(Areas::Waterfall);
+}
 
-int Waterfall::simulate () {
-    int time = times.segments["waterfall"];
-    time += Undertale::encounter_time_random(times.static_blcons["waterfall"]);
+template <typename Rng>
+int Waterfall::simulate_draws (Rng& rng, SampleContext& context) {
+    int time = use_static_time(context, Areas::Waterfall);
+    time += Undertale::encounter_time_random(rng, context, times.static_blcons[Areas::Waterfall]);
     
     // already counting the first 2 scripted
     int kills = 2;
     // scripted double mold
-    time += Undertale::glowing_water_steps(kills);
+    time += Undertale::glowing_water_steps(rng, context, kills);
     kills = 4;
     
     // the random glowing water encounter
-    int encounter = Undertale::glowing_water_encounter();
+    int encounter = Undertale::glowing_water_encounter(rng, context);
 
     if (encounter == Encounters::SingleAaron || encounter == Encounters::SingleWoshua) {
         kills++;
         if (encounter == Encounters::SingleAaron) {
-            time += times.segments["sgl-aaron-shoes"];
+            time += use_segment(context, Segments::SglAaronShoes);
         } else {
-            time += times.segments["sgl-woshua-shoes"];
+            time += use_segment(context, Segments::SglWoshuaShoes);
         }
     } else {
         kills += 2;
         if (encounter == Encounters::WoshuaAaron) {
-            time += times.segments["woshua-aaron-surprise"];
+            time += use_segment(context, Segments::WoshuaAaronSurprise);
         } else {
-            time += times.segments["dbl-mold-shoes"];
+            time += use_segment(context, Segments::DblMoldShoes);
         }
     }
     // shyren and glad dummy
     kills += 2;
     // first two grind encounters (first being temmie) happen with same number of kills, second steps are without room transition
-    time += Undertale::waterfall_grind_steps(kills) +  Undertale::waterfall_grind_same_room(kills);
+    time += Undertale::waterfall_grind_steps(rng, context, kills) +  Undertale::waterfall_grind_same_room(rng, context, kills);
 
     kills += 3;
     // remaining encounters before going to the mazes
     for (int i = 0; i < 2; i++) {
-        time += Undertale::waterfall_grind_steps(kills);
+        time += Undertale::waterfall_grind_steps(rng, context, kills);
         kills += 2;
     }
 
@@ -48,35 +60,35 @@ int Waterfall::simulate () {
     int first_maze_progress = 0;
     int second_maze_progress = 0;
     while (kills < 18) {
-        int steps = Undertale::waterfall_grind_steps(kills);
+        int steps = Undertale::waterfall_grind_steps(rng, context, kills);
         if (kills < 16) {
             first_maze_progress++;
-            if (first_maze_progress == 1) steps = fix_step_total(steps, "mushroom-maze");
+            if (first_maze_progress == 1) steps = fix_step_total(context, steps, Segments::MushroomMaze);
             else {
-                time += times.segments["mushroom-maze-going-back"] + times.segments["mushroom-maze-exit-after-backtrack"];
-                time += Undertale::encounter_time_random();
+                time += use_segment(context, Segments::MushroomMazeGoingBack) + use_segment(context, Segments::MushroomMazeExitAfterBacktrack);
+                time += Undertale::encounter_time_random(rng, context);
             }
         } else {
             second_maze_progress++;
-            if (second_maze_progress == 1) steps = fix_step_total(steps, "crystal-maze");
+            if (second_maze_progress == 1) steps = fix_step_total(context, steps, Segments::CrystalMaze);
             else {
-                time += times.segments["crystal-going-back"] + times.segments["crystal-exit-after-backtrack"];
-                time += Undertale::encounter_time_random();
+                time += use_segment(context, Segments::CrystalGoingBack) + use_segment(context, Segments::CrystalExitAfterBacktrack);
+                time += Undertale::encounter_time_random(rng, context);
             }
         }
         
-        int encounter = Undertale::waterfall_grind_encounter();
+        int encounter = Undertale::waterfall_grind_encounter(rng, context);
 
         if (encounter == Encounters::WoshuaAaron || encounter == Encounters::WoshuaMoldbygg) {
             bool flee = kills == 17;
             kills += 2;
             if (encounter == Encounters::WoshuaAaron) {
-                time += flee ? times.segments["woshua-aaron-17"] : times.segments["woshua-aaron-surprise"];
+                time += flee ? use_segment(context, Segments::WoshuaAaron17) : use_segment(context, Segments::WoshuaAaronSurprise);
             } else {
-                time += flee ? times.segments["woshua-mold-17"] : times.segments["woshua-mold"];
+                time += flee ? use_segment(context, Segments::WoshuaMold17) : use_segment(context, Segments::WoshuaMold);
             }
         } else {
-            time += times.segments["temmie"];
+            time += use_segment(context, Segments::Temmie);
             kills++;
         }
 
@@ -85,3 +97,97 @@ int Waterfall::simulate () {
     
     return time;
 }
+
+int Waterfall::simulate (Random& rng, SampleContext& context) {
+    return simulate_draws(rng, context);
+}
+
+int Waterfall::simulate (QuasiRandom& rng, SampleContext& context) {
+    return simulate_draws(rng, context);
+}
+
+
+// same as `simulate`, but following every branch with its chance to get the exact distribution
+// the mazes are tracked by kills and how many encounters were done in each maze
+ProbabilityDistribution Waterfall::get_exact_dist () {
+    ProbabilityDistribution time = Undertale::encounter_time_chances(times.static_blcons[Areas::Waterfall]);
+    time.shift(times.static_times[Areas::Waterfall]);
+
+    // scripted double mold
+    time.convolve(ProbabilityDistribution(Undertale::glowing_water_steps_chances(2)));
+
+    // the random glowing water encounter, then the scripted kills and steps that depend on the kills
+    std::map<std::tuple<int, int, int>, ProbabilityDistribution> states;
+    for (const auto& encounter : Undertale::glowing_water_encounter_chances()) {
+        ProbabilityDistribution branch = time;
+        int kills = 4;
+        if (encounter.first == Encounters::SingleAaron || encounter.first == Encounters::SingleWoshua) {
+            kills++;
+            branch.shift(encounter.first == Encounters::SingleAaron ? times.segments[Segments::SglAaronShoes] : times.segments[Segments::SglWoshuaShoes]);
+        } else {
+            kills += 2;
+            branch.shift(encounter.first == Encounters::WoshuaAaron ? times.segments[Segments::WoshuaAaronSurprise] : times.segments[Segments::DblMoldShoes]);
+        }
+        // shyren and glad dummy
+        kills += 2;
+        branch.convolve(ProbabilityDistribution(Undertale::waterfall_grind_steps_chances(kills)));
+        branch.convolve(ProbabilityDistribution(Undertale::waterfall_grind_same_room_chances(kills)));
+        kills += 3;
+        for (int i = 0; i < 2; i++) {
+            branch.convolve(ProbabilityDistribution(Undertale::waterfall_grind_steps_chances(kills)));
+            kills += 2;
+        }
+        branch.scale(encounter.second);
+        add_state(states, { kills, 0, 0 }, branch);
+    }
+
+    // random encounters in the maze, the progress only matters up to the second encounter
+    ProbabilityDistribution result(1);
+    for (const auto& [state, dist] : states) {
+        auto [kills, first_maze_progress, second_maze_progress] = state;
+        if (kills >= 18) {
+            result.add(dist);
+            continue;
+        }
+
+        ProbabilityDistribution walked = dist;
+        Chances step_chances = Undertale::waterfall_grind_steps_chances(kills);
+        if (kills < 16) {
+            first_maze_progress = std::min(first_maze_progress + 1, 2);
+            if (first_maze_progress == 1) walked.convolve(fix_step_chances(step_chances, Segments::MushroomMaze));
+            else {
+                walked.convolve(ProbabilityDistribution(step_chances));
+                walked.shift(times.segments[Segments::MushroomMazeGoingBack] + times.segments[Segments::MushroomMazeExitAfterBacktrack]);
+                walked.convolve(Undertale::encounter_time_chances(1));
+            }
+        } else {
+            second_maze_progress = std::min(second_maze_progress + 1, 2);
+            if (second_maze_progress == 1) walked.convolve(fix_step_chances(step_chances, Segments::CrystalMaze));
+            else {
+                walked.convolve(ProbabilityDistribution(step_chances));
+                walked.shift(times.segments[Segments::CrystalGoingBack] + times.segments[Segments::CrystalExitAfterBacktrack]);
+                walked.convolve(Undertale::encounter_time_chances(1));
+            }
+        }
+
+        for (const auto& encounter : Undertale::waterfall_grind_encounter_chances()) {
+            ProbabilityDistribution branch = walked;
+            int encounter_kills;
+            if (encounter.first == Encounters::WoshuaAaron || encounter.first == Encounters::WoshuaMoldbygg) {
+                bool flee = kills == 17;
+                encounter_kills = 2;
+                if (encounter.first == Encounters::WoshuaAaron) {
+                    branch.shift(flee ? times.segments[Segments::WoshuaAaron17] : times.segments[Segments::WoshuaAaronSurprise]);
+                } else {
+                    branch.shift(flee ? times.segments[Segments::WoshuaMold17] : times.segments[Segments::WoshuaMold]);
+                }
+            } else {
+                branch.shift(times.segments[Segments::Temmie]);
+                encounter_kills = 1;
+            }
+            branch.scale(encounter.second);
+            add_state(states, { kills + encounter_kills, first_maze_progress, second_maze_progress }, branch);
+        }
+    }
+    return result;
+}
\ No newline at end of file
@@ -6,9 +6,21 @@
 // Simulator for Waterfall
 class Waterfall : public Simulator {
 public:
-    Waterfall (Times& times_value);
+    Waterfall (const Times& times_value);
 
-    int simulate() override;
+    int simulate (Random& rng, SampleContext& context) override;
+
+    int simulate (QuasiRandom& rng, SampleContext& context) override;
+
+    ProbabilityDistribution get_exact_dist () override;
+
+    Simulator* clone (const Times& times_value) override;
+
+    std::string get_cache_key () override;
+
+private:
+    template <typename Rng>
+    int simulate_draws (Rng& rng, SampleContext& context);
 };
 
 #endif
\ No newline at end of file